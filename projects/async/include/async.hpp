@@ -0,0 +1,252 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+class Scheduler;
+
+/**
+	@class Task
+	@brief Coroutine run by a Scheduler.
+
+	A function returning Task is a coroutine that can co_await channels and
+	I/O readiness. It doesn't start running until it is passed to
+	Scheduler::spawn(). Exceptions thrown by it are rethrown by
+	Scheduler::run().
+*/
+class Task
+{
+public:
+	struct promise_type
+	{
+		std::exception_ptr error;
+
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	Task(Task&& other) noexcept;
+	Task& operator=(Task&& other) noexcept;
+	~Task();
+
+private:
+	friend class Scheduler;
+
+	explicit Task(std::coroutine_handle<promise_type> handle);
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+/**
+	@class Scheduler
+	@brief Single-threaded executor for Tasks.
+
+	Runs the ready coroutines one after another on the calling thread. When
+	none is ready, it blocks until one of the file descriptors awaited with
+	readable() or stdinReadable() has data (epoll on Linux, poll on other
+	POSIX systems). File descriptors that cannot be polled (regular files,
+	or on other systems) are considered always readable.
+*/
+class Scheduler
+{
+public:
+	Scheduler();
+	~Scheduler();
+
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	/// Take ownership of a task and make it ready to run.
+	void spawn(Task task);
+
+	/**
+		@brief Run all the tasks until they finish.
+
+		If a task throws, the other tasks keep running (so that they can
+		finish their work) and the first exception is rethrown at the end,
+		also if the remaining tasks are left waiting for each other. Otherwise,
+		throws std::logic_error if they wait for each other forever
+		(deadlock).
+	*/
+	void run();
+
+	/// Make a suspended coroutine ready to run.
+	void schedule(std::coroutine_handle<> handle);
+
+	/// Awaitable that suspends the coroutine until a file descriptor is readable.
+	struct ReadableAwaiter
+	{
+		Scheduler& scheduler;
+		int fd; /// -1 never waits
+		std::streambuf* buffer; /// Buffer reading from 'fd' (may be nullptr)
+
+		bool await_ready() const;
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const {}
+	};
+
+	/// Wait until a file descriptor is readable.
+	ReadableAwaiter readable(int fd);
+
+	/**
+		@brief Wait until std::cin has input.
+
+		While std::cin reads from the standard input, this waits on descriptor
+		0, unless the buffer of std::cin still has data available (in_avail()
+		!= 0). If std::cin was marked as redirected with setStdinRedirected()
+		(e.g., to a string stream), it never waits, whatever descriptor 0 is.
+	*/
+	ReadableAwaiter stdinReadable();
+
+	/**
+		@brief Mark std::cin as redirected away from the standard input.
+
+		Whoever replaces the buffer of std::cin with one that doesn't read
+		descriptor 0 must call this with true, and with false after restoring
+		it. std::ios::sync_with_stdio() doesn't redirect std::cin.
+	*/
+	static void setStdinRedirected(bool redirected);
+
+private:
+	std::vector<std::coroutine_handle<Task::promise_type>> tasks; /// Owned tasks
+	std::deque<std::coroutine_handle<>> ready; /// Coroutines ready to run
+	std::vector<std::pair<int, std::coroutine_handle<>>> waiting; /// Coroutines waiting for I/O
+	int epollFd; /// -1 if epoll is not available
+
+	/// Block until some waiting coroutine can run, and schedule it.
+	void waitForIo();
+};
+
+/**
+	@class Channel
+	@brief Bounded FIFO queue connecting coroutines (pipeline stages).
+
+	push() suspends the producer while the channel is full (backpressure) and
+	pop() suspends the consumer while it is empty. After close(), pending and
+	future push() calls fail, and pop() returns the remaining items and then
+	std::nullopt. All the coroutines must run on the same Scheduler.
+*/
+template <class T>
+class Channel
+{
+	struct PopAwaiter;
+
+	struct PushAwaiter
+	{
+		Channel& channel;
+		T value;
+		std::coroutine_handle<> handle;
+		bool accepted = false;
+
+		bool await_ready()
+		{
+			if (channel.closed) return true;
+
+			if (channel.poppers.size())   // Hand the value to a waiting consumer
+			{
+				PopAwaiter* popper = channel.poppers.front();
+				channel.poppers.pop_front();
+				popper->result = std::move(value);
+				channel.scheduler.schedule(popper->handle);
+				return accepted = true;
+			}
+
+			if (channel.items.size() < channel.capacity)
+			{
+				channel.items.push_back(std::move(value));
+				return accepted = true;
+			}
+
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			handle = h;
+			channel.pushers.push_back(this);
+		}
+
+		/// Return whether the value was accepted (false if the channel was closed).
+		bool await_resume() const { return accepted; }
+	};
+
+	struct PopAwaiter
+	{
+		Channel& channel;
+		std::optional<T> result;
+		std::coroutine_handle<> handle;
+
+		bool await_ready()
+		{
+			if (channel.items.empty()) return channel.closed;
+
+			result = std::move(channel.items.front());
+			channel.items.pop_front();
+
+			if (channel.pushers.size())   // Room for a waiting producer
+			{
+				PushAwaiter* pusher = channel.pushers.front();
+				channel.pushers.pop_front();
+				channel.items.push_back(std::move(pusher->value));
+				pusher->accepted = true;
+				channel.scheduler.schedule(pusher->handle);
+			}
+
+			return true;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			handle = h;
+			channel.poppers.push_back(this);
+		}
+
+		/// Return the next item, or std::nullopt if the channel is closed and empty.
+		std::optional<T> await_resume() { return std::move(result); }
+	};
+
+public:
+	Channel(Scheduler& scheduler, size_t capacity)
+		: scheduler(scheduler), capacity(capacity ? capacity : 1), closed(false) {}
+
+	Channel(const Channel&) = delete;
+	Channel& operator=(const Channel&) = delete;
+
+	/// Awaitable that adds an item (co_await returns false if the channel is closed).
+	PushAwaiter push(T value) { return PushAwaiter{*this, std::move(value), {}, false}; }
+
+	/// Awaitable that takes the next item (co_await returns std::nullopt at the end).
+	PopAwaiter pop() { return PopAwaiter{*this, std::nullopt, {}}; }
+
+	/// Close the channel and wake up all the waiting coroutines.
+	void close()
+	{
+		closed = true;
+		for (PushAwaiter* pusher : pushers) scheduler.schedule(pusher->handle);
+		for (PopAwaiter* popper : poppers) scheduler.schedule(popper->handle);
+		pushers.clear();
+		poppers.clear();
+	}
+
+	/// Whether no item is waiting to be popped.
+	bool empty() const { return items.empty(); }
+
+private:
+	Scheduler& scheduler;
+	size_t capacity;
+	bool closed;
+	std::deque<T> items;
+	std::deque<PushAwaiter*> pushers; /// Producers waiting for room
+	std::deque<PopAwaiter*> poppers; /// Consumers waiting for items
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#include "async.hpp"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#endif
+
+namespace {
+
+/// Whether std::cin was redirected away from the standard input.
+bool stdinRedirected = false;
+
+} // namespace
+
+Task::Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+Task::Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+Task &Task::operator=(Task &&other) noexcept {
+  if (this != &other) {
+    if (handle)
+      handle.destroy();
+    handle = std::exchange(other.handle, {});
+  }
+  return *this;
+}
+
+Task::~Task() {
+  if (handle)
+    handle.destroy();
+}
+
+Scheduler::Scheduler() : epollFd(-1) {
+#if defined(__linux__)
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+Scheduler::~Scheduler() {
+  for (auto task : tasks)
+    task.destroy();
+#if defined(__linux__)
+  if (epollFd >= 0)
+    close(epollFd);
+#endif
+}
+
+void Scheduler::spawn(Task task) {
+  tasks.push_back(std::exchange(task.handle, {}));
+  ready.push_back(tasks.back());
+}
+
+void Scheduler::run() {
+  std::exception_ptr error;
+  size_t finished = 0;
+
+  while (finished < tasks.size()) {
+    if (ready.empty()) {
+      if (waiting.empty()) {
+        // Tasks left waiting for a failed one: report the failure.
+        if (error)
+          std::rethrow_exception(error);
+        throw std::logic_error("Scheduler deadlock: all tasks are waiting.");
+      }
+      waitForIo();
+      continue;
+    }
+
+    std::coroutine_handle<> handle = ready.front();
+    ready.pop_front();
+    handle.resume();
+
+    // Every coroutine run by the scheduler is a Task.
+    auto task = std::coroutine_handle<Task::promise_type>::from_address(
+        handle.address());
+    if (task.done()) {
+      ++finished;
+      if (task.promise().error && !error)
+        error = task.promise().error;
+    }
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void Scheduler::schedule(std::coroutine_handle<> handle) {
+  ready.push_back(handle);
+}
+
+Scheduler::ReadableAwaiter Scheduler::readable(int fd) {
+  return ReadableAwaiter{*this, fd, nullptr};
+}
+
+Scheduler::ReadableAwaiter Scheduler::stdinReadable() {
+  // A redirected std::cin doesn't read descriptor 0: waiting on it could
+  // block forever (e.g., on a terminal or a pipe that is never written).
+  // The buffer of std::cin is not compared with the original one, since
+  // std::ios::sync_with_stdio() replaces it.
+  if (stdinRedirected)
+    return ReadableAwaiter{*this, -1, nullptr};
+  return ReadableAwaiter{*this, 0, std::cin.rdbuf()};
+}
+
+void Scheduler::setStdinRedirected(bool redirected) {
+  stdinRedirected = redirected;
+}
+
+bool Scheduler::ReadableAwaiter::await_ready() const {
+  return fd < 0 || (buffer && buffer->in_avail() != 0);
+}
+
+void Scheduler::ReadableAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  scheduler.waiting.emplace_back(fd, handle);
+}
+
+void Scheduler::waitForIo() {
+  // Coroutines whose descriptor turns out to be readable (or not pollable).
+  std::vector<int> readableFds;
+
+  // Other ready coroutines are never blocked: I/O is only awaited when
+  // nothing else can run.
+#if defined(__linux__)
+  if (epollFd >= 0) {
+    std::vector<int> polled;
+    for (const auto &w : waiting) {
+      if (std::find(polled.begin(), polled.end(), w.first) != polled.end())
+        continue;
+
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.fd = w.first;
+      if (epoll_ctl(epollFd, EPOLL_CTL_ADD, w.first, &event) == 0 ||
+          errno == EEXIST)
+        polled.push_back(w.first);
+      else
+        readableFds.push_back(w.first); // Regular files can't be polled
+    }
+
+    if (readableFds.empty() && polled.size()) {
+      epoll_event events[16];
+      int count;
+      do
+        count = epoll_wait(epollFd, events, 16, -1);
+      while (count < 0 && errno == EINTR);
+      if (count < 0)
+        throw std::system_error(errno, std::generic_category(), "epoll_wait");
+
+      for (int i = 0; i < count; i++)
+        readableFds.push_back(events[i].data.fd);
+    }
+
+    for (int fd : polled)
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+#elif defined(__unix__) || defined(__APPLE__)
+  std::vector<pollfd> polled;
+  for (const auto &w : waiting)
+    polled.push_back({w.first, POLLIN, 0});
+
+  int count;
+  do
+    count = poll(polled.data(), polled.size(), -1);
+  while (count < 0 && errno == EINTR);
+  if (count < 0)
+    throw std::system_error(errno, std::generic_category(), "poll");
+
+  for (const auto &p : polled)
+    if (p.revents)
+      readableFds.push_back(p.fd);
+#endif
+
+  if (epollFd < 0 && readableFds.empty()) // No way of polling: don't wait
+    for (const auto &w : waiting)
+      readableFds.push_back(w.first);
+
+  // Schedule the coroutines waiting for the readable descriptors.
+  auto isReadable =
+      [&readableFds](const std::pair<int, std::coroutine_handle<>> &w) {
+        return std::find(readableFds.begin(), readableFds.end(), w.first) !=
+               readableFds.end();
+      };
+  for (const auto &w : waiting)
+    if (isReadable(w))
+      schedule(w.second);
+  waiting.erase(std::remove_if(waiting.begin(), waiting.end(), isReadable),
+                waiting.end());
+}
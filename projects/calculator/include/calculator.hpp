@@ -1,22 +1,38 @@
 #ifndef CALCULATOR_HPP
 #define CALCULATOR_HPP
 
+#include <span>
 #include <vector>
 #include <string>
 
+#include "async.hpp"
+
 /// Parity of a number (even or odd).
 enum Parity {any = 0, odd = 1, even = 2};
 
+/// Operators available (same numbers as in the options menu).
+enum Operator {none = 0, addition = 1, subtraction = 2, multiplication = 3, division = 4};
+
 /// Data for each number, either entered number or resulting number.
 struct NumberInfo
 {
 	NumberInfo(long value = 0, size_t order = 0, std::string description = "");
+	NumberInfo(long value, size_t order, long operand1, long operand2, long symbol);
 	void clear();
 
+	/// Get the description, generating it from the operation if needed.
+	std::string getDescription() const;
+
 	long value;
 	int parity;   // 0 (any), 1 (odd), 2 (even)
 	size_t order;
 	std::string description;
+
+	// Operation that produced 'value'. If symbol != none, the description is
+	// generated from it when it is printed or saved (not when computed).
+	long operand1;
+	long operand2;
+	long symbol;
 };
 
 /**
@@ -44,9 +60,37 @@ public:
 	long getOption() const;
 	long getValue(std::string adjective = "an");
 	void compute(long value1, long value2, long symbol);
+
+	/**
+		@brief Run the interactive session until the user selects Exit.
+
+		Shows the options and computes the operations entered in std::cin, like
+		calling getOption(), getValue() and compute() in a loop. Reading the
+		lines, computing and writing the prompts are pipeline stages run by a
+		Scheduler, so prompts are shown while waiting for input without extra
+		threads. Throws if std::cin ends before Exit or a number is invalid.
+	*/
+	void runSession();
+
+	/// Compute values1[i] (symbol) values2[i] for each i and record the results. Throws std::invalid_argument on invalid operator, division or sizes.
+	void computeBatch(long symbol, std::span<const long> values1, std::span<const long> values2);
+
+	/// Like computeBatch(), but only write the results to 'results' (nothing is recorded). 'results' may be one of the operands (computing in place).
+	static void computeKernel(long symbol, std::span<const long> values1, std::span<const long> values2, std::span<long> results);
+
 	void printRecords(Parity parity = Parity::any) const;
 	void printRecord(size_t orderPos) const;
 	void clear();
+
+private:
+	/// Pipeline stage that reads one line from STDIN for each item popped from 'requests', until EOF or 'requests' is closed.
+	Task readLinesStage(Scheduler& scheduler, Channel<bool>& requests, Channel<std::string>& lines);
+
+	/// Pipeline stage that asks for lines, computes the operations and outputs the prompts. Closes the channels when finishing (also when throwing).
+	Task computeStage(Channel<bool>& requests, Channel<std::string>& lines, Channel<std::string>& output);
+
+	/// Pipeline stage that prints the text received (flushing when nothing else is waiting).
+	Task writeStage(Channel<std::string>& output);
 };
 
 #endif
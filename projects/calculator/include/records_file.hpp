@@ -0,0 +1,42 @@
+#ifndef RECORDS_FILE_HPP
+#define RECORDS_FILE_HPP
+
+#include <vector>
+#include <string>
+
+#include "calculator.hpp"
+
+/// Maximum memory (bytes) that loading a binary records file may use by default.
+const size_t defaultRecordsBudget = size_t(1) << 30;
+
+/**
+	@brief Load records from a binary file.
+
+	Format (version 1, portable, little-endian):
+	  - Header: magic "CALC", 32-bit version, 64-bit number of records.
+	  - Records: 64-bit value, 32-bit parity, 64-bit order, 32-bit description
+	    length, description bytes.
+
+	The file is read in large blocks. Every parity must be 0 to 2, every length
+	is validated against the bytes left in the file and the total memory
+	against 'memoryBudget' before anything is allocated. Validated records are decoded in parallel (on the
+	global ThreadPool) a few MiB at a time. Files written by older versions (raw native layout,
+	without header) are still accepted, but only if they are made entirely of
+	valid records and don't start with something close to the magic.
+
+	Returns false if the file cannot be opened. Throws std::runtime_error with
+	the offset of the bad data if the file is corrupt.
+*/
+bool loadBinaryRecords(const std::string& path, std::vector<NumberInfo>& records,
+                       size_t memoryBudget = defaultRecordsBudget);
+
+/// Save records to a binary file (see loadBinaryRecords). Records are encoded in parallel. Returns false on failure.
+bool saveBinaryRecords(const std::string& path, const std::vector<NumberInfo>& records);
+
+/// Load records from a text file (one "value parity order description" line per record), parsing lines in parallel a few MiB at a time. Returns false if the file cannot be opened.
+bool loadTextRecords(const std::string& path, std::vector<NumberInfo>& records);
+
+/// Save records to a text file (see loadTextRecords). Records are formatted in parallel. Returns false on failure.
+bool saveTextRecords(const std::string& path, const std::vector<NumberInfo>& records);
+
+#endif
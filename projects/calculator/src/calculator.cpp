@@ -1,13 +1,87 @@
 #include "calculator.hpp"
+#include "records_file.hpp"
+#include "thread_pool.hpp"
 
 #include <iostream>
 #include <iomanip>
 #include <sstream>
-#include <fstream>
 #include <filesystem>
+#include <stdexcept>
+#include <climits>
+#include <algorithm>
+
+namespace
+{
+	const size_t kernelGrain = 1 << 16;   // Operations computed by each task
+	const size_t recordsGrain = 4096;     // Records created by each task
+	const size_t pipelineCapacity = 16;   // Lines or texts buffered between session stages
+
+	// Operator kernels. Arithmetic is done on unsigned values so that overflow
+	// wraps around instead of being undefined (the bits are the same).
+	struct Add { static long apply(long a, long b) { return (long)((unsigned long)a + (unsigned long)b); } };
+	struct Sub { static long apply(long a, long b) { return (long)((unsigned long)a - (unsigned long)b); } };
+	struct Mul { static long apply(long a, long b) { return (long)((unsigned long)a * (unsigned long)b); } };
+	struct Div { static long apply(long a, long b) { return a / b; } };
+
+	/// Apply one operator to contiguous arrays. The loop has no branches, so it can be vectorized.
+	/// 'results' may be one of the operands: each element is only read before it is written.
+	template<class Op>
+	void applyKernel(const long* values1, const long* values2, long* results, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			results[i] = Op::apply(values1[i], values2[i]);
+	}
+
+	/// Apply a valid operator to contiguous arrays. The operator is selected once for the whole batch.
+	void applyOperator(long symbol, const long* values1, const long* values2, long* results, size_t size)
+	{
+		switch (symbol)
+		{
+			case addition:       applyKernel<Add>(values1, values2, results, size); break;
+			case subtraction:    applyKernel<Sub>(values1, values2, results, size); break;
+			case multiplication: applyKernel<Mul>(values1, values2, results, size); break;
+			case division:       applyKernel<Div>(values1, values2, results, size); break;
+		}
+	}
+
+	/// Check the operands of a division (division by zero or LONG_MIN / -1 are not allowed).
+	bool validDivision(long value1, long value2)
+	{
+		return value2 != 0 && !(value1 == LONG_MIN && value2 == -1);
+	}
+
+	/// Get the message of an invalid operation (nullptr if it is valid).
+	const char* operationError(long value1, long value2, long symbol)
+	{
+		if (symbol < addition || symbol > division) return "Invalid operator";
+		if (symbol == division && !validDivision(value1, value2)) return "Invalid division";
+		return nullptr;
+	}
+
+	/// Get the number in the first word of a line. Throws if it is not a number.
+	long parseNumber(std::string line)
+	{
+		std::istringstream iss(line);
+		iss >> line;   // Get first word of the line
+
+		return std::stol(line);
+	}
+
+	const char* symbolString(long symbol)
+	{
+		switch (symbol)
+		{
+			case addition:       return " + ";
+			case subtraction:    return " - ";
+			case multiplication: return " * ";
+			case division:       return " / ";
+			default:             return " ? ";
+		}
+	}
+}
 
 NumberInfo::NumberInfo(long value, size_t order, std::string description)
-	: value(value), order(order), description(description)
+	: value(value), order(order), description(description), operand1(0), operand2(0), symbol(none)
 {
 	if(value % 2)
 		parity = Parity::odd;
@@ -15,12 +89,26 @@ NumberInfo::NumberInfo(long value, size_t order, std::string description)
 		parity = Parity::even;
 }
 
+NumberInfo::NumberInfo(long value, size_t order, long operand1, long operand2, long symbol)
+	: value(value), parity(value % 2 ? Parity::odd : Parity::even), order(order),
+	  operand1(operand1), operand2(operand2), symbol(symbol)
+{ }
+
 void NumberInfo::clear()
 {
 	value = 0;
 	order = 0;
 	parity = Parity::even;
 	description = "";
+	operand1 = operand2 = 0;
+	symbol = none;
+}
+
+std::string NumberInfo::getDescription() const
+{
+	if (symbol == none) return description;
+
+	return std::to_string(operand1) + symbolString(symbol) + std::to_string(operand2) + " = " + std::to_string(value);
 }
 
 Calculator::Calculator(std::string filePath)
@@ -28,51 +116,15 @@ Calculator::Calculator(std::string filePath)
 {
 	if (!filePath.size()) return;
 
-	std::ifstream iFile;
 	std::string ext = getExtension(filePath);
+	bool loaded = false;
 
 	if (ext == ".txt")
-	{
-		iFile.open(filePath);
-		if(iFile.is_open())
-		{
-			std::string line;
-			NumberInfo entry;
-			while (std::getline(iFile, line))
-			{
-				std::istringstream iss(line);
-				iss >> entry.value >> entry.parity >> entry.order;
-				std::getline(iss >> std::ws, entry.description);
-
-				numbersInfo.push_back(entry);
-				entry.clear();
-			}
-		}
-	}
+		loaded = loadTextRecords(filePath, numbersInfo);
 	else if (ext == ".bin")
-	{
-		iFile.open(filePath, std::ios_base::binary);
-		if(iFile.is_open())
-		{
-			NumberInfo entry;
-			size_t strLength;
-			for(;;)
-			{
-				if(!iFile.read(reinterpret_cast<char*>(&entry.value), sizeof(entry.value))) break;
-				iFile.read(reinterpret_cast<char*>(&entry.parity), sizeof(entry.parity));
-				iFile.read(reinterpret_cast<char*>(&entry.order), sizeof(entry.order));
-				iFile.read(reinterpret_cast<char*>(&strLength), sizeof(strLength));
-				entry.description.resize(strLength);
-				iFile.read(&entry.description[0], strLength);
-
-				numbersInfo.push_back(entry);
-				entry.clear();
-			}
-		}
-	}
+		loaded = loadBinaryRecords(filePath, numbersInfo);
 
-	if (iFile.is_open()) iFile.close();
-	else std::cout << "Input file cannot be opened\n";
+	if (!loaded) std::cout << "Input file cannot be opened\n";
 	
 	count = numbersInfo.size();
 }
@@ -81,38 +133,15 @@ Calculator::~Calculator()
 {
 	if (!filePath.size()) return;
 
-	std::ofstream oFile;
 	std::string ext = getExtension(filePath);
+	bool saved = false;
 
 	if(ext == ".txt")
-	{
-		oFile.open(filePath);
-		if(oFile.is_open())
-			for (const auto& record : numbersInfo)
-				oFile 
-					<< std::to_string(record.value) << ' '
-					<< std::to_string(record.parity) << ' '
-					<< std::to_string(record.order) << ' '
-					<< record.description << '\n';
-	}
+		saved = saveTextRecords(filePath, numbersInfo);
 	else if (ext == ".bin")
-	{
-		size_t strLength;
-		oFile.open(filePath, std::ios_base::binary);
-		if(oFile.is_open())
-			for (const auto& record : numbersInfo)
-			{
-				oFile.write(reinterpret_cast<const char*>(&record.value), sizeof(record.value));
-				oFile.write(reinterpret_cast<const char*>(&record.parity), sizeof(record.parity));
-				oFile.write(reinterpret_cast<const char*>(&record.order), sizeof(record.order));
-				strLength = record.description.size();
-				oFile.write(reinterpret_cast<const char*>(&strLength), sizeof(strLength));
-				oFile.write(record.description.c_str(), strLength);                   // then content
-			}
-	}
+		saved = saveBinaryRecords(filePath, numbersInfo);
 
-	if(oFile.is_open()) oFile.close();
-	else std::cout << "Output file cannot be opened\n";
+	if (!saved) std::cout << "Output file cannot be opened\n";
 }
 
 long Calculator::getInputNumber() const
@@ -122,10 +151,7 @@ long Calculator::getInputNumber() const
 	if (!std::getline(std::cin, line))   // Get input line
 		throw std::runtime_error("Failure when reading from std::cin.");
 
-	std::istringstream iss(line);
-	iss >> line;   // Get first word of the line
-	
-	return std::stol(line);
+	return parseNumber(line);
 }
 
 std::string Calculator::getExtension(const std::string& filename) const
@@ -173,7 +199,7 @@ void Calculator::printRecords(Parity parity) const
 			<< std::setw(8) << numbersInfo[i].value << " " 
 			<< std::setw(4) << numbersInfo[i].parity << " " 
 			<< std::setw(4) << numbersInfo[i].order << " "
-			<< std::setw(20) << numbersInfo[i].description << "\n";
+			<< std::setw(20) << numbersInfo[i].getDescription() << "\n";
 }
 
 void Calculator::printRecord(size_t orderPos) const
@@ -187,7 +213,7 @@ void Calculator::printRecord(size_t orderPos) const
 			<< std::setw(8) << numbersInfo[orderPos].value << " " 
 			<< std::setw(4) << numbersInfo[orderPos].parity << " " 
 			<< std::setw(4) << numbersInfo[orderPos].order << " "
-			<< std::setw(20) << numbersInfo[orderPos].description << "\n";
+			<< std::setw(20) << numbersInfo[orderPos].getDescription() << "\n";
 }
 
 void Calculator::showOptions() const
@@ -204,34 +230,145 @@ void Calculator::showOptions() const
 
 void Calculator::compute(long value1, long value2, long symbol)
 {
+	if (const char* error = operationError(value1, value2, symbol))
+	{
+		std::cout << error << "\n";
+		return;
+	}
+
 	long result;
-	std::string symbolStr;
+	computeKernel(symbol, {&value1, 1}, {&value2, 1}, {&result, 1});
+	numbersInfo.push_back(NumberInfo(result, ++count, value1, value2, symbol));
+}
+
+void Calculator::runSession()
+{
+	showOptions();
+
+	Scheduler scheduler;
+	Channel<bool> requests(scheduler, 1);
+	Channel<std::string> lines(scheduler, pipelineCapacity);
+	Channel<std::string> output(scheduler, pipelineCapacity);
+
+	scheduler.spawn(readLinesStage(scheduler, requests, lines));
+	scheduler.spawn(computeStage(requests, lines, output));
+	scheduler.spawn(writeStage(output));
+	scheduler.run();
+}
+
+Task Calculator::readLinesStage(Scheduler& scheduler, Channel<bool>& requests, Channel<std::string>& lines)
+{
+	std::string line;
+
+	// Lines are only read when asked for, so that nothing waits for STDIN
+	// after the user exits.
+	while (std::optional<bool> request = co_await requests.pop())
+	{
+		co_await scheduler.stdinReadable();
+		if (!std::getline(std::cin, line)) break;   // EOF or error
+		if (!co_await lines.push(line)) break;      // The compute stage failed
+	}
+
+	lines.close();
+}
+
+Task Calculator::computeStage(Channel<bool>& requests, Channel<std::string>& lines, Channel<std::string>& output)
+{
+	const char* const prompts[] = {"Select an available option (1-5): ", "Enter first operand: ", "Enter second operand: "};
+	long values[3];   // Option (operator), first and second operands
+	size_t step = 0;
+
+	try
+	{
+		for (;;)
+		{
+			co_await output.push(prompts[step]);
+			co_await requests.push(true);
+			std::optional<std::string> line = co_await lines.pop();
+			if (!line)
+				throw std::runtime_error("Failure when reading from std::cin.");
+
+			long value = parseNumber(*line);
+			if (step == 0 && (value < 1 || value > 5)) continue;   // Ask again
+			if (step == 0 && value == 5) break;                   // Exit
+			if (step > 0) numbersInfo.push_back(NumberInfo(value, ++count));
+
+			values[step] = value;
+			if (++step < 3) continue;
+
+			step = 0;
+			if (const char* error = operationError(values[1], values[2], values[0]))
+				co_await output.push(std::string(error) + "\n");
+			else
+				compute(values[1], values[2], values[0]);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		requests.close();   // Stop the read stage
+		output.close();     // Let the write stage finish
+		throw;
+	}
 
-	switch (symbol)
+	requests.close();
+	output.close();
+}
+
+Task Calculator::writeStage(Channel<std::string>& output)
+{
+	while (std::optional<std::string> text = co_await output.pop())
 	{
-		case 1:
-			result = value1 + value2;
-			symbolStr = " + ";
-			break;
-		case 2:
-			result = value1 - value2;
-			symbolStr = " - ";
-			break;
-		case 3:
-			result = value1 * value2;
-			symbolStr = " * ";
-			break;
-		case 4:
-			result = value1 / value2;
-			symbolStr = " / ";
-			break;
-		default:
-			std::cout << "Invalid operator\n";
-			return;
+		std::cout << *text;
+		if (output.empty()) std::cout << std::flush;   // Nothing else to write: show it before waiting
 	}
+}
 
-	std::string description(std::to_string(value1) + symbolStr + std::to_string(value2) + " = " + std::to_string(result));
-	numbersInfo.push_back(NumberInfo(result, ++count, description));
+void Calculator::computeBatch(long symbol, std::span<const long> values1, std::span<const long> values2)
+{
+	size_t size = values1.size();
+	std::vector<long> results(size);
+	computeKernel(symbol, values1, values2, results);
+
+	// Records are created in parallel (they are independent).
+	size_t first = numbersInfo.size();
+	numbersInfo.resize(first + size);
+	parallelFor(0, size, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			numbersInfo[first + i] = NumberInfo(results[i], count + i + 1, values1[i], values2[i], symbol);
+	}, recordsGrain);
+	count += size;
+}
+
+void Calculator::computeKernel(long symbol, std::span<const long> values1, std::span<const long> values2, std::span<long> results)
+{
+	size_t size = values1.size();
+	if (values2.size() != size || results.size() != size)
+		throw std::invalid_argument("Operand and result sizes differ");
+
+	if (symbol < addition || symbol > division)
+		throw std::invalid_argument("Invalid operator " + std::to_string(symbol));
+
+	// Report the first invalid division (chunks are checked in parallel).
+	if (symbol == division)
+	{
+		size_t invalid = parallelReduce(size_t(0), size, size, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				if (!validDivision(values1[i], values2[i])) return i;
+			return size;
+		},
+		[](size_t a, size_t b) { return std::min(a, b); }, kernelGrain);
+
+		if (invalid < size)
+			throw std::invalid_argument("Invalid division at position " + std::to_string(invalid));
+	}
+
+	// Large batches are split into chunks computed in parallel.
+	parallelFor(0, size, [&](size_t begin, size_t end)
+	{
+		applyOperator(symbol, values1.data() + begin, values2.data() + begin, results.data() + begin, end - begin);
+	}, kernelGrain);
 }
 
 void Calculator::clear()
@@ -4,22 +4,14 @@
 
 int main()
 {
+    // Let std::cin buffer stdin itself, so that the session stages only wait
+    // for input when its buffer is empty.
+    std::ios::sync_with_stdio(false);
+
     try
     {
-        long option, value1, value2;
-
         Calculator calc("storedData.bin");
-	    calc.showOptions();
-
-	    for (;;)
-	    {
-	    	option = calc.getOption();
-	    	if(option == 5) break;
-	    	value1 = calc.getValue("first");
-	    	value2 = calc.getValue("second");
-	    	calc.compute(value1, value2, option);
-	    }
-
+	    calc.runSession();
 	    calc.printRecords();
     }
     catch (std::exception &e)
@@ -0,0 +1,349 @@
+#include "records_file.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+	const char recordsMagic[4] = {'C', 'A', 'L', 'C'};
+	const uint32_t recordsVersion = 1;
+	const size_t headerSize = 16;        // magic, version, number of records
+	const size_t fixedRecordSize = 24;   // value, parity, order, description length
+	const size_t blockSize = 1 << 20;
+	const size_t recordsPerTask = 4096;    // Records encoded or decoded by each task
+	const size_t decodeWindow = 4 << 20;   // Raw records read before decoding them in parallel
+
+	void putUint(std::string& out, uint64_t value, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; i++)
+			out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+	uint64_t getUint(const char* in, size_t bytes)
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < bytes; i++)
+			value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+		return value;
+	}
+
+	/// Sequential reader that gets data from the file in large blocks.
+	class BlockReader
+	{
+	public:
+		BlockReader(std::ifstream& file)
+			: file(file), buffer(blockSize), pos(0), end(0), position(0) { }
+
+		/// Copy the next 'size' bytes to 'out'. False if the file ends before.
+		bool read(char* out, size_t size)
+		{
+			while (size)
+			{
+				if (pos == end)
+				{
+					file.read(buffer.data(), buffer.size());
+					end = static_cast<size_t>(file.gcount());
+					pos = 0;
+					if (!end) return false;
+				}
+
+				size_t chunk = std::min(size, end - pos);
+				std::memcpy(out, buffer.data() + pos, chunk);
+				out += chunk;
+				size -= chunk;
+				pos += chunk;
+				position += chunk;
+			}
+			return true;
+		}
+
+		/// Offset (in the file) of the next byte to read.
+		uint64_t offset() const { return position; }
+
+	private:
+		std::ifstream& file;
+		std::vector<char> buffer;
+		size_t pos, end;
+		uint64_t position;
+	};
+
+	/// Append a record in binary format (without header).
+	void encodeBinary(std::string& out, const NumberInfo& record)
+	{
+		std::string description = record.getDescription();
+		putUint(out, static_cast<uint64_t>(static_cast<int64_t>(record.value)), 8);
+		putUint(out, static_cast<uint32_t>(record.parity), 4);
+		putUint(out, record.order, 8);
+		putUint(out, description.size(), 4);
+		out += description;
+	}
+
+	/// Decode a record in binary format (the fixed part followed by the description).
+	void decodeBinary(const char* in, NumberInfo& entry)
+	{
+		entry.value = static_cast<long>(static_cast<int64_t>(getUint(in, 8)));
+		entry.parity = static_cast<int>(static_cast<int32_t>(getUint(in + 8, 4)));
+		entry.order = static_cast<size_t>(getUint(in + 12, 8));
+		entry.description.assign(in + fixedRecordSize, getUint(in + 20, 4));
+	}
+
+	/// Append a record as a line of text: value, parity, order and description.
+	void encodeText(std::string& out, const NumberInfo& record)
+	{
+		out += std::to_string(record.value) + ' ' + std::to_string(record.parity) + ' ' +
+		       std::to_string(record.order) + ' ' + record.getDescription() + '\n';
+	}
+
+	/// Parse a line of text written by encodeText().
+	void decodeText(const std::string& line, NumberInfo& entry)
+	{
+		std::istringstream iss(line);
+		iss >> entry.value >> entry.parity >> entry.order;
+		std::getline(iss >> std::ws, entry.description);
+	}
+
+	/**
+		Write records encoded in parallel. Each task encodes a chunk of records
+		(descriptions are generated here, which is the expensive part) and the
+		chunks are written in order, a window of chunks at a time, so memory use
+		doesn't depend on the number of records.
+	*/
+	template <class Encode>
+	void writeRecords(std::ofstream& oFile, const std::vector<NumberInfo>& records, Encode encode)
+	{
+		const size_t window = recordsPerTask * 4 * ThreadPool::defaultNumThreads();
+		std::vector<std::string> chunks;
+
+		for (size_t first = 0; first < records.size(); first += window)
+		{
+			size_t last = std::min(records.size(), first + window);
+			chunks.assign((last - first - 1) / recordsPerTask + 1, std::string());
+
+			parallelFor(first, last, [&](size_t begin, size_t end)
+			{
+				std::string& chunk = chunks[(begin - first) / recordsPerTask];
+				for (size_t i = begin; i < end; i++)
+					encode(chunk, records[i]);
+			}, recordsPerTask);
+
+			for (const auto& chunk : chunks)
+				oFile.write(chunk.data(), chunk.size());
+		}
+	}
+
+	[[noreturn]] void corrupt(const std::string& path, uint64_t offset, const std::string& reason)
+	{
+		throw std::runtime_error("Corrupt file " + path + " at offset " + std::to_string(offset) + ": " + reason);
+	}
+
+	/// Whether the first bytes of a file look like a damaged or truncated magic of the versioned format.
+	bool looksVersioned(const char* data, size_t size)
+	{
+		size_t bytes = std::min(size, sizeof(recordsMagic));
+		size_t matches = 0;
+		for (size_t i = 0; i < bytes; i++)
+			matches += data[i] == recordsMagic[i];
+		return bytes && matches >= std::min<size_t>(bytes, 3);
+	}
+
+	/**
+		Load a file written before the versioned format (native sizes and
+		endianness, no header). The whole file must be made of complete, valid
+		records; anything else is reported as corrupt with its offset.
+	*/
+	void loadLegacyRecords(std::ifstream& iFile, const std::string& path, uint64_t fileSize,
+	                       std::vector<NumberInfo>& records, size_t memoryBudget)
+	{
+		NumberInfo entry;
+		size_t strLength;
+		const uint64_t fixedSize = sizeof(entry.value) + sizeof(entry.parity) + sizeof(entry.order) + sizeof(strLength);
+		uint64_t offset = 0;
+		size_t used = 0;
+
+		iFile.seekg(0);
+		while (offset < fileSize)
+		{
+			if (fileSize - offset < fixedSize ||
+			    !iFile.read(reinterpret_cast<char*>(&entry.value), sizeof(entry.value)) ||
+			    !iFile.read(reinterpret_cast<char*>(&entry.parity), sizeof(entry.parity)) ||
+			    !iFile.read(reinterpret_cast<char*>(&entry.order), sizeof(entry.order)) ||
+			    !iFile.read(reinterpret_cast<char*>(&strLength), sizeof(strLength)))
+				corrupt(path, offset, "truncated record");
+
+			if (entry.parity < Parity::any || entry.parity > Parity::even)
+				corrupt(path, offset, "invalid parity " + std::to_string(entry.parity));
+
+			// Never trust the length stored in the file: it cannot exceed the remaining bytes.
+			if (strLength > fileSize - offset - fixedSize)
+				corrupt(path, offset, "description length " + std::to_string(strLength) + " exceeds the file size");
+			used += sizeof(NumberInfo) + strLength;
+			if (used > memoryBudget)
+				throw std::runtime_error("Records file " + path + " exceeds the memory budget of " + std::to_string(memoryBudget) + " bytes");
+
+			entry.description.resize(strLength);
+			if (!iFile.read(&entry.description[0], strLength))
+				corrupt(path, offset, "truncated description");
+
+			records.push_back(entry);
+			entry.clear();
+			offset += fixedSize + strLength;
+		}
+	}
+}
+
+bool loadBinaryRecords(const std::string& path, std::vector<NumberInfo>& records, size_t memoryBudget)
+{
+	std::ifstream iFile(path, std::ios_base::binary);
+	if (!iFile.is_open()) return false;
+
+	std::error_code error;
+	uint64_t fileSize = std::filesystem::file_size(path, error);
+	if (error) return false;
+
+	BlockReader reader(iFile);
+	char header[headerSize];
+	size_t headerBytes = static_cast<size_t>(std::min<uint64_t>(fileSize, headerSize));
+	if (!reader.read(header, headerBytes))
+		corrupt(path, reader.offset(), "cannot read the header");
+
+	if (headerBytes < headerSize || std::memcmp(header, recordsMagic, sizeof(recordsMagic)))
+	{
+		// A damaged or truncated versioned file must not be parsed as legacy records.
+		if (looksVersioned(header, headerBytes))
+			corrupt(path, 0, headerBytes < headerSize ? "truncated header" : "bad magic");
+
+		iFile.clear();
+		loadLegacyRecords(iFile, path, fileSize, records, memoryBudget);
+		return true;
+	}
+
+	if (getUint(header + 4, 4) != recordsVersion)
+		corrupt(path, 4, "unsupported version " + std::to_string(getUint(header + 4, 4)));
+
+	// Check the number of records before reserving memory for them.
+	uint64_t numRecords = getUint(header + 8, 8);
+	if (numRecords > (fileSize - headerSize) / fixedRecordSize)
+		corrupt(path, 8, std::to_string(numRecords) + " records do not fit in " + std::to_string(fileSize) + " bytes");
+
+	uint64_t used = numRecords * sizeof(NumberInfo);
+	if (used > memoryBudget)
+		throw std::runtime_error("Records file " + path + " exceeds the memory budget of " + std::to_string(memoryBudget) + " bytes");
+	records.reserve(records.size() + numRecords);
+
+	// Records are validated and copied sequentially into a window of raw
+	// records, which is then decoded in parallel.
+	std::string window;
+	std::vector<size_t> starts;   // Start of each record in 'window'
+	auto decodeRecords = [&]()
+	{
+		size_t base = records.size();
+		records.resize(base + starts.size());
+		parallelFor(0, starts.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				decodeBinary(window.data() + starts[i], records[base + i]);
+		}, recordsPerTask);
+		window.clear();
+		starts.clear();
+	};
+
+	for (uint64_t i = 0; i < numRecords; i++)
+	{
+		uint64_t recordOffset = reader.offset();
+		size_t start = window.size();
+		window.resize(start + fixedRecordSize);
+		if (!reader.read(&window[start], fixedRecordSize))
+			corrupt(path, recordOffset, "truncated record");
+
+		int32_t parity = static_cast<int32_t>(getUint(&window[start + 8], 4));
+		if (parity < Parity::any || parity > Parity::even)
+			corrupt(path, recordOffset, "invalid parity " + std::to_string(parity));
+
+		uint64_t strLength = getUint(&window[start + 20], 4);
+		if (strLength > fileSize - reader.offset())
+			corrupt(path, recordOffset, "description length " + std::to_string(strLength) + " exceeds the file size");
+		used += strLength;
+		if (used > memoryBudget)
+			throw std::runtime_error("Records file " + path + " exceeds the memory budget of " + std::to_string(memoryBudget) + " bytes");
+
+		window.resize(start + fixedRecordSize + strLength);
+		if (!reader.read(&window[start + fixedRecordSize], strLength))
+			corrupt(path, recordOffset, "truncated description");
+
+		starts.push_back(start);
+		if (window.size() >= decodeWindow)
+			decodeRecords();
+	}
+	decodeRecords();
+
+	if (reader.offset() != fileSize)
+		corrupt(path, reader.offset(), "unexpected data after the last record");
+
+	return true;
+}
+
+bool saveBinaryRecords(const std::string& path, const std::vector<NumberInfo>& records)
+{
+	std::ofstream oFile(path, std::ios_base::binary | std::ios_base::trunc);
+	if (!oFile.is_open()) return false;
+
+	std::string block(recordsMagic, sizeof(recordsMagic));   // Header
+	putUint(block, recordsVersion, 4);
+	putUint(block, records.size(), 8);
+
+	oFile.write(block.data(), block.size());
+	writeRecords(oFile, records, encodeBinary);
+	oFile.close();
+	return !oFile.fail();
+}
+
+bool loadTextRecords(const std::string& path, std::vector<NumberInfo>& records)
+{
+	std::ifstream iFile(path);
+	if (!iFile.is_open()) return false;
+
+	// Lines are read sequentially into a window, which is then parsed in
+	// parallel, so memory use doesn't depend on the size of the file.
+	std::vector<std::string> lines;
+	size_t windowBytes = 0;
+	auto decodeLines = [&]()
+	{
+		size_t base = records.size();
+		records.resize(base + lines.size());
+		parallelFor(0, lines.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				decodeText(lines[i], records[base + i]);
+		}, recordsPerTask);
+		lines.clear();
+		windowBytes = 0;
+	};
+
+	std::string line;
+	while (std::getline(iFile, line))
+	{
+		windowBytes += line.size();
+		lines.push_back(std::move(line));
+		if (windowBytes >= decodeWindow)
+			decodeLines();
+	}
+	decodeLines();
+
+	return true;
+}
+
+bool saveTextRecords(const std::string& path, const std::vector<NumberInfo>& records)
+{
+	std::ofstream oFile(path);
+	if (!oFile.is_open()) return false;
+
+	writeRecords(oFile, records, encodeText);
+	oFile.close();
+	return !oFile.fail();
+}
@@ -0,0 +1,169 @@
+#ifndef TESTS_CALCULATOR_HPP
+#define TESTS_CALCULATOR_HPP
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "calculator.hpp"
+#include "records_file.hpp"
+
+/// Tests for the calculator computations and records files.
+void tests();
+
+/**
+	@class InputRedirector
+	@brief Redirect std::cin to a string.
+
+	Redirect std::cin from STDIN to a string. This allows to pass input with a
+	string instead of with STDIN. Redirection is made during construction.
+*/
+class InputRedirector
+{
+public:
+	InputRedirector(const std::string& input);
+
+	/// Redirect back std::cin to STDIN.
+	void reset();
+
+private:
+	std::streambuf* originalCin; // Original cin
+	std::istringstream newCin; // Redirected cin
+};
+
+/**
+	@class OutputRedirector
+	@brief Redirect std::cout to a string.
+
+	Redirect std::cout from STDOUT to a string. This allows to pass output to a
+	string instead of to STDOUT. Redirection is made during construction.
+*/
+class OutputRedirector
+{
+public:
+	OutputRedirector();
+
+	/// Redirect back std::cout to STDOUT.
+	void reset();
+
+	/// Get data stored in the output string.
+	std::string inputData();
+
+private:
+	std::streambuf* originalCout; // Original cout
+	std::ostringstream newCout; // Redirected cout
+};
+
+/**
+	@class Test_Calculator
+	@brief Tool for testing the Calculator computations.
+
+	Class for creating unit tests for Calculator::computeKernel and
+	Calculator::computeBatch.
+*/
+class Test_Calculator
+{
+public:
+	Test_Calculator();
+
+	/// Test Calculator::computeKernel with valid operations.
+	bool computeKernel(long symbol, std::vector<long> values1, std::vector<long> values2,
+	                   std::vector<long> expected);
+
+	/// Test Calculator::computeKernel writing the results over its operands
+	/// (each one, and both at once when they are the same).
+	bool kernelInPlace(long symbol, std::vector<long> values1, std::vector<long> values2,
+	                   std::vector<long> expected);
+
+	/// Test that Calculator::computeKernel rejects an invalid operator, division or sizes.
+	bool invalidKernel(long symbol, std::vector<long> values1, std::vector<long> values2,
+	                   size_t numResults);
+
+	/**
+		@brief Test Calculator::computeBatch.
+
+		The records must be the same as calling compute() once per pair, also
+		after saving them to a file with 'extension' and loading them again
+		(descriptions are generated when saving). 'description' is the
+		expected description of the first record.
+	*/
+	bool computeBatch(long symbol, std::vector<long> values1, std::vector<long> values2,
+	                  std::string extension, std::string description);
+
+	/**
+		@brief Test Calculator::runSession with 'input' as STDIN input.
+
+		The records printed afterwards must match 'expected', and the session
+		must throw only if 'expectError' (input ending before Exit, or an
+		invalid number).
+	*/
+	bool session(std::string input, std::string expected, bool expectError);
+
+	/**
+		@brief Test the calculator application through a pipe.
+
+		The calculator binary reads 'input' from a pipe that is kept open.
+		'answer' must be printed before the pipe is closed (EOF). Only run on
+		POSIX systems.
+	*/
+	bool calculatorBinaryPipe(std::string input, std::string answer);
+
+private:
+	size_t testsCount;
+
+	void printOk();
+	void printFail();
+};
+
+/**
+	@class Test_RecordsFile
+	@brief Tool for testing the records file loaders and savers.
+
+	Class for creating unit tests for the functions of records_file.hpp. Each
+	test writes its own temporary file and removes it when it finishes.
+*/
+class Test_RecordsFile
+{
+public:
+	Test_RecordsFile();
+
+	/// Test saving and loading 'records' in the format of 'extension' (".bin" or ".txt").
+	bool roundTrip(std::vector<NumberInfo> records, std::string extension);
+
+	/// Test loading a file with the layout written before the versioned format.
+	bool legacyFile(std::vector<NumberInfo> records);
+
+	/**
+		@brief Test that loadBinaryRecords rejects a corrupt file.
+
+		'data' is the content of the file. It must be rejected with an
+		exception reporting 'offset', and a Calculator using it must fail
+		without overwriting it.
+	*/
+	bool corruptFile(std::string data, uint64_t offset);
+
+	/// Test that loading 'records' with a budget of 'memoryBudget' bytes is rejected.
+	bool overBudget(std::vector<NumberInfo> records, size_t memoryBudget);
+
+	/// Get the content of a binary file saved with 'records' (for building corrupt files).
+	std::string binaryData(std::vector<NumberInfo> records);
+
+	/// Get the content of a file with the layout written before the versioned format.
+	std::string legacyData(std::vector<NumberInfo> records);
+
+private:
+	size_t testsCount;
+
+	void printOk();
+	void printFail();
+
+	/// Get the path of the temporary file of the current test.
+	std::string tempPath(std::string extension) const;
+
+	/// Print OK or FAIL depending on whether two lists of records are equal.
+	bool checkRecords(const std::vector<NumberInfo>& result,
+	                  const std::vector<NumberInfo>& expected);
+};
+
+#endif
@@ -0,0 +1,12 @@
+#include "tests.hpp"
+
+int main() {
+  try {
+    tests();
+  } catch (std::exception &e) {
+    std::cout << "Error: " << e.what() << std::endl;
+  }
+
+  std::cin.get();
+  return 0;
+}
@@ -0,0 +1,633 @@
+#include <chrono>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "tests.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+InputRedirector::InputRedirector(const std::string &input)
+    : originalCin(std::cin.rdbuf()), newCin(input) {
+  std::cin.rdbuf(newCin.rdbuf()); // Redirect std::cin
+  Scheduler::setStdinRedirected(true);
+}
+
+void InputRedirector::reset() {
+  std::cin.rdbuf(originalCin);
+  Scheduler::setStdinRedirected(false);
+}
+
+OutputRedirector::OutputRedirector() : originalCout(std::cout.rdbuf()) {
+  std::cout.rdbuf(newCout.rdbuf()); // Redirect std::cout
+}
+
+void OutputRedirector::reset() { std::cout.rdbuf(originalCout); }
+
+std::string OutputRedirector::inputData() { return newCout.str(); }
+
+Test_Calculator::Test_Calculator() : testsCount(0) {}
+
+bool Test_Calculator::computeKernel(long symbol, std::vector<long> values1,
+                                    std::vector<long> values2,
+                                    std::vector<long> expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::vector<long> results(values1.size());
+
+  // Act (execution)
+  try {
+    Calculator::computeKernel(symbol, values1, values2, results);
+  } catch (const std::exception &e) {
+    printFail();
+    return true;
+  }
+
+  // Assert (verification)
+  if (results == expected) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_Calculator::kernelInPlace(long symbol, std::vector<long> values1,
+                                    std::vector<long> values2,
+                                    std::vector<long> expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::vector<long> first(values1), second(values2), same(values1);
+
+  // Act (execution)
+  try {
+    Calculator::computeKernel(symbol, first, values2, first);
+    Calculator::computeKernel(symbol, values1, second, second);
+    Calculator::computeKernel(symbol, same, same, same);
+  } catch (const std::exception &e) {
+    printFail();
+    return true;
+  }
+
+  // Assert (verification)
+  std::vector<long> squared(values1.size());
+  Calculator::computeKernel(symbol, values1, values1, squared);
+  if (first == expected && second == expected && same == squared) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_Calculator::invalidKernel(long symbol, std::vector<long> values1,
+                                    std::vector<long> values2,
+                                    size_t numResults) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::vector<long> results(numResults);
+  Calculator calc;
+
+  // Act (execution)
+  bool kernelRejected = false, batchRejected = false;
+  try {
+    Calculator::computeKernel(symbol, values1, values2, results);
+  } catch (const std::invalid_argument &e) {
+    kernelRejected = true;
+  }
+
+  try {
+    calc.computeBatch(symbol, values1, values2);
+  } catch (const std::invalid_argument &e) {
+    batchRejected = true;
+  }
+
+  OutputRedirector outputDir;
+  calc.printRecords();
+  outputDir.reset();
+
+  // Assert (verification)
+  bool batchInvalid = numResults == values1.size(); // Same operands
+  bool noRecords =
+      outputDir.inputData().find("No records stored") != std::string::npos;
+  if (kernelRejected && (!batchInvalid || (batchRejected && noRecords))) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_Calculator::computeBatch(long symbol, std::vector<long> values1,
+                                   std::vector<long> values2,
+                                   std::string extension,
+                                   std::string description) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("calculator_tests_batch" + extension))
+                         .string();
+  std::filesystem::remove(path);
+  std::string single, batch, reloaded;
+  auto printed = [](const Calculator &calc) {
+    OutputRedirector outputDir;
+    calc.printRecords();
+    outputDir.reset();
+    return outputDir.inputData();
+  };
+
+  // Act (execution)
+  try {
+    Calculator calcSingle;
+    for (size_t i = 0; i < values1.size(); i++)
+      calcSingle.compute(values1[i], values2[i], symbol);
+    single = printed(calcSingle);
+
+    {
+      OutputRedirector outputDir; // The file doesn't exist yet (message)
+      Calculator calcBatch(path); // Saves its records on destruction
+      outputDir.reset();
+      calcBatch.computeBatch(symbol, values1, values2);
+      batch = printed(calcBatch);
+    }
+
+    Calculator calcReloaded(path);
+    reloaded = printed(calcReloaded);
+    calcReloaded.clear(); // Don't save the records again
+  } catch (const std::exception &e) {
+  }
+  std::filesystem::remove(path);
+
+  // Assert (verification)
+  if (single.size() && batch == single && reloaded == single &&
+      reloaded.find(description) != std::string::npos) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_Calculator::session(std::string input, std::string expected,
+                              bool expectError) {
+  testsCount++;
+
+  // Arrange (setup)
+  Calculator calc;
+  InputRedirector inputDir(input);
+  OutputRedirector outputDir;
+
+  // Act (execution)
+  bool thrown = false;
+  try {
+    calc.runSession();
+  } catch (const std::exception &e) {
+    thrown = true;
+  }
+  inputDir.reset();
+  std::string prompts = outputDir.inputData();
+  calc.printRecords();
+  outputDir.reset();
+  std::string records = outputDir.inputData().substr(prompts.size());
+
+  // Assert (verification)
+  if (thrown == expectError && records == expected &&
+      prompts.find("Available options") != std::string::npos) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_Calculator::calculatorBinaryPipe(std::string input,
+                                           std::string answer) {
+  testsCount++;
+
+  bool answered = false;
+#if defined(__unix__) || defined(__APPLE__)
+  // Arrange (setup)
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "calculator_tests_pipe";
+  std::filesystem::create_directories(dir); // The records file is saved there
+  int toCalculator[2], fromCalculator[2];
+  if (pipe(toCalculator) || pipe(fromCalculator)) {
+    printFail();
+    return true;
+  }
+  std::signal(SIGPIPE, SIG_IGN); // Don't die if the calculator exits early
+
+  pid_t pid = fork();
+  if (pid == 0) { // Child: run the calculator on the pipes
+    dup2(toCalculator[0], 0);
+    dup2(fromCalculator[1], 1);
+    close(toCalculator[0]);
+    close(toCalculator[1]);
+    close(fromCalculator[0]);
+    close(fromCalculator[1]);
+    if (chdir(dir.c_str()) == 0)
+      execl(CALCULATOR_BINARY, CALCULATOR_BINARY, static_cast<char *>(nullptr));
+    _exit(127);
+  }
+  close(toCalculator[0]);
+  close(fromCalculator[1]);
+
+  // Act (execution)
+  // The input is written without closing the pipe: 'answer' must arrive
+  // while the calculator could still read more input.
+  if (pid > 0 && write(toCalculator[1], input.data(), input.size()) ==
+                     static_cast<ssize_t>(input.size())) {
+    std::string output;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!answered) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      pollfd polled{fromCalculator[0], POLLIN, 0};
+      if (left.count() <= 0 || poll(&polled, 1, left.count()) <= 0)
+        break;
+
+      char buffer[4096];
+      ssize_t count = read(fromCalculator[0], buffer, sizeof(buffer));
+      if (count <= 0)
+        break;
+      output.append(buffer, count);
+      answered = output.find(answer) != std::string::npos;
+    }
+  }
+
+  close(toCalculator[1]); // EOF: the calculator finishes
+  char buffer[4096];
+  while (read(fromCalculator[0], buffer, sizeof(buffer)) > 0)
+    ;
+  close(fromCalculator[0]);
+  if (pid > 0)
+    waitpid(pid, nullptr, 0);
+  std::filesystem::remove_all(dir);
+#else
+  (void)input;
+  (void)answer;
+  answered = true;
+#endif
+
+  // Assert (verification)
+  if (answered) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+void Test_Calculator::printOk() {
+  std::cout << "OK - Test " << testsCount << std::endl;
+}
+
+void Test_Calculator::printFail() {
+  std::cout << "FAIL - Test " << testsCount << std::endl;
+}
+
+Test_RecordsFile::Test_RecordsFile() : testsCount(0) {}
+
+bool Test_RecordsFile::roundTrip(std::vector<NumberInfo> records,
+                                 std::string extension) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string path = tempPath(extension);
+  std::vector<NumberInfo> loaded;
+
+  // Act (execution)
+  bool saved = extension == ".bin" ? saveBinaryRecords(path, records)
+                                   : saveTextRecords(path, records);
+  bool opened = extension == ".bin" ? loadBinaryRecords(path, loaded)
+                                    : loadTextRecords(path, loaded);
+  std::filesystem::remove(path);
+
+  // Assert (verification)
+  if (!saved || !opened) {
+    printFail();
+    return true;
+  }
+  return checkRecords(loaded, records);
+}
+
+bool Test_RecordsFile::legacyFile(std::vector<NumberInfo> records) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string path = tempPath(".bin");
+  std::ofstream(path, std::ios_base::binary) << legacyData(records);
+  std::vector<NumberInfo> loaded;
+
+  // Act (execution)
+  bool opened = false;
+  try {
+    opened = loadBinaryRecords(path, loaded);
+  } catch (const std::exception &e) {
+  }
+  std::filesystem::remove(path);
+
+  // Assert (verification)
+  if (!opened) {
+    printFail();
+    return true;
+  }
+  return checkRecords(loaded, records);
+}
+
+bool Test_RecordsFile::corruptFile(std::string data, uint64_t offset) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string path = tempPath(".bin");
+  std::ofstream(path, std::ios_base::binary) << data;
+  std::vector<NumberInfo> loaded;
+  std::string expected = " at offset " + std::to_string(offset) + ":";
+
+  // Act (execution)
+  bool rejected = false, calculatorRejected = false;
+  try {
+    loadBinaryRecords(path, loaded);
+  } catch (const std::runtime_error &e) {
+    rejected = std::string(e.what()).find(expected) != std::string::npos;
+  }
+
+  try {
+    Calculator calc(path); // Saves its records on destruction
+  } catch (const std::runtime_error &e) {
+    calculatorRejected = true;
+  }
+
+  std::ifstream file(path, std::ios_base::binary);
+  std::string content((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  file.close();
+  std::filesystem::remove(path);
+
+  // Assert (verification)
+  if (rejected && calculatorRejected && content == data) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_RecordsFile::overBudget(std::vector<NumberInfo> records,
+                                  size_t memoryBudget) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string path = tempPath(".bin");
+  saveBinaryRecords(path, records);
+  std::vector<NumberInfo> loaded;
+
+  // Act (execution)
+  bool rejected = false;
+  try {
+    loadBinaryRecords(path, loaded, memoryBudget);
+  } catch (const std::runtime_error &e) {
+    rejected = std::string(e.what()).find("memory budget") != std::string::npos;
+  }
+  std::filesystem::remove(path);
+
+  // Assert (verification)
+  if (rejected) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+std::string Test_RecordsFile::binaryData(std::vector<NumberInfo> records) {
+  std::string path = tempPath(".bin");
+  saveBinaryRecords(path, records);
+
+  std::ifstream file(path, std::ios_base::binary);
+  std::string data((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+  file.close();
+  std::filesystem::remove(path);
+  return data;
+}
+
+std::string Test_RecordsFile::legacyData(std::vector<NumberInfo> records) {
+  std::string data;
+  auto append = [&data](const void *field, size_t size) {
+    data.append(static_cast<const char *>(field), size);
+  };
+
+  for (const auto &record : records) {
+    std::string description = record.getDescription();
+    size_t length = description.size();
+    append(&record.value, sizeof(record.value));
+    append(&record.parity, sizeof(record.parity));
+    append(&record.order, sizeof(record.order));
+    append(&length, sizeof(length));
+    data += description;
+  }
+  return data;
+}
+
+std::string Test_RecordsFile::tempPath(std::string extension) const {
+  return (std::filesystem::temp_directory_path() /
+          ("calculator_tests_" + std::to_string(testsCount) + extension))
+      .string();
+}
+
+bool Test_RecordsFile::checkRecords(const std::vector<NumberInfo> &result,
+                                    const std::vector<NumberInfo> &expected) {
+  bool equal = result.size() == expected.size();
+  for (size_t i = 0; equal && i < result.size(); i++)
+    equal = result[i].value == expected[i].value &&
+            result[i].parity == expected[i].parity &&
+            result[i].order == expected[i].order &&
+            result[i].getDescription() == expected[i].getDescription();
+
+  if (equal) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+void Test_RecordsFile::printOk() {
+  std::cout << "OK - Test " << testsCount << std::endl;
+}
+
+void Test_RecordsFile::printFail() {
+  std::cout << "FAIL - Test " << testsCount << std::endl;
+}
+
+void tests() {
+  Test_Calculator calculator;
+  const long max = LONG_MAX, min = LONG_MIN;
+
+  std::cout << "Testing Calculator::computeKernel():" << std::endl;
+
+  calculator.computeKernel(addition, {}, {}, {});
+  calculator.computeKernel(addition, {1, -5, 7}, {2, 3, -7}, {3, -2, 0});
+  calculator.computeKernel(subtraction, {1, -5, 7}, {2, 3, -7}, {-1, -8, 14});
+  calculator.computeKernel(multiplication, {4, -5, 0}, {3, 3, 9}, {12, -15, 0});
+  calculator.computeKernel(division, {7, -7, 1, min}, {2, 2, 3, 1},
+                           {3, -3, 0, min});
+  calculator.computeKernel(addition, {max, min}, {1, -1}, {min, max});
+  calculator.computeKernel(subtraction, {min, max}, {1, -1}, {max, min});
+  calculator.computeKernel(multiplication, {max, min}, {2, -1}, {-2, min});
+
+  std::vector<long> many1(100000), many2(100000), manySums(100000);
+  for (size_t i = 0; i < many1.size(); i++) {
+    many1[i] = long(i) * 3;
+    many2[i] = long(i % 11) - 5;
+    manySums[i] = many1[i] + many2[i];
+  }
+  calculator.kernelInPlace(addition, {1, -5, 7}, {2, 3, -7}, {3, -2, 0});
+  calculator.kernelInPlace(multiplication, {4, -5, 0}, {3, 3, 9},
+                           {12, -15, 0});
+  calculator.kernelInPlace(addition, many1, many2, manySums);
+
+  std::cout << "Testing Calculator::computeKernel() (invalid):" << std::endl;
+
+  calculator.invalidKernel(none, {1}, {2}, 1);
+  calculator.invalidKernel(5, {1}, {2}, 1);
+  calculator.invalidKernel(division, {1, 2, 3}, {1, 0, 1}, 3);
+  calculator.invalidKernel(division, {min}, {-1}, 1);
+  calculator.invalidKernel(addition, {1, 2}, {1}, 2);
+  calculator.invalidKernel(addition, {1, 2}, {1, 2}, 1);
+
+  std::vector<long> large1(200000), large2(200000);
+  for (size_t i = 0; i < large1.size(); i++) {
+    large1[i] = long(i) - 100000;
+    large2[i] = long(i % 7) + 1;
+  }
+  std::vector<long> largeDivisors(large2);
+  largeDivisors.back() = 0; // Only the last chunk is invalid
+  calculator.invalidKernel(division, large1, largeDivisors, large1.size());
+
+  std::cout << "Testing Calculator::computeBatch():" << std::endl;
+
+  calculator.computeBatch(addition, {7}, {-2}, ".bin", "7 + -2 = 5");
+  calculator.computeBatch(subtraction, {max, 3}, {-1, 5}, ".bin",
+                          std::to_string(max) + " - -1 = " + std::to_string(min));
+  calculator.computeBatch(multiplication, {6, -4}, {7, 2}, ".txt", "6 * 7 = 42");
+  calculator.computeBatch(division, large1, large2, ".bin",
+                          "-100000 / 1 = -100000");
+  calculator.computeBatch(division, large1, large2, ".txt",
+                          "-100000 / 1 = -100000");
+
+  std::cout << "Testing Calculator::runSession():" << std::endl;
+
+  std::string noRecords = "All recorded entries and results (value, parity, "
+                          "order, description):\nNo records stored\n";
+  std::string header = "All recorded entries and results (value, parity, "
+                       "order, description):\n";
+  calculator.session("5\n", noRecords, false);
+  calculator.session("", noRecords, true);
+  calculator.session("1\n2\n", header +
+                                    "2        2    1                        \n",
+                     true);
+  calculator.session("0\n6\n1\n2\n3\n5\n",
+                     header + "2        2    1                        \n"
+                              "3        1    2                        \n"
+                              "5        1    3    2 + 3 = 5           \n",
+                     false);
+  calculator.session("4\n7\n0\n5\n",
+                     header + "7        1    1                        \n"
+                              "0        2    2                        \n",
+                     false);
+  calculator.session("x\n", noRecords, true);
+  calculator.calculatorBinaryPipe("1\n2\n3\n", "Select an available option "
+                                               "(1-5): Enter first operand: "
+                                               "Enter second operand: Select");
+  calculator.calculatorBinaryPipe("3\n6\n7\n5\n", "6 * 7 = 42");
+
+  Test_RecordsFile test;
+  std::vector<NumberInfo> records = {
+      NumberInfo(7, 1), NumberInfo(-2, 2), NumberInfo(5, 3, 7, -2, addition),
+      NumberInfo(0, 4, "zero with a description")};
+  std::vector<NumberInfo> many;
+  for (size_t i = 0; i < 20000; i++)
+    many.push_back(NumberInfo(long(i) * 3, i + 1, long(i), 3, multiplication));
+
+  std::cout << "Testing records files (round trip):" << std::endl;
+
+  test.roundTrip({}, ".bin");
+  test.roundTrip(records, ".bin");
+  test.roundTrip(many, ".bin");
+  test.roundTrip({}, ".txt");
+  test.roundTrip(records, ".txt");
+  test.roundTrip(many, ".txt");
+
+  std::cout << "Testing records files (legacy format):" << std::endl;
+
+  test.legacyFile({});
+  test.legacyFile(records);
+
+  std::cout << "Testing records files (corrupt):" << std::endl;
+
+  std::string data = test.binaryData(records);
+  std::string badMagic(data), badVersion(data), badCount(data), badLength(data);
+  badMagic[3] = 'X';
+  badVersion[4] = 2;
+  badCount[8] = 100;
+  badLength[16 + 22] = 1; // Description length of the first record: 64 KiB
+  test.corruptFile(badMagic, 0);
+  test.corruptFile(badVersion, 4);
+  test.corruptFile(badCount, 8);
+  test.corruptFile(badLength, 16);
+  test.corruptFile(data + "extra", data.size());
+  test.corruptFile(std::string(100, 'x'), 0); // Not even legacy records
+
+  std::string badRecordParity(data), negativeParity(data);
+  badRecordParity[16 + 24 + 8] = 3; // Second record (the first one has no description)
+  for (size_t i = 0; i < 4; i++)
+    negativeParity[16 + 8 + i] = '\xff'; // First record: -1
+  test.corruptFile(badRecordParity, 16 + 24);
+  test.corruptFile(negativeParity, 16);
+
+  std::string legacy = test.legacyData(records);
+  std::string badParity(legacy);
+  badParity[sizeof(long)] = 7;
+  test.corruptFile(badParity, 0);
+
+  std::cout << "Testing records files (truncated):" << std::endl;
+
+  test.corruptFile(data.substr(0, 3), 0);
+  test.corruptFile(data.substr(0, 12), 0);
+  size_t lastDescription = records.back().description.size();
+  size_t lastRecord = data.size() - 24 - lastDescription;
+  size_t lastLegacyRecord = legacy.size() - lastDescription -
+                            (sizeof(long) + sizeof(int) + 2 * sizeof(size_t));
+  test.corruptFile(data.substr(0, 16 + 10), 8); // Records don't fit
+  test.corruptFile(data.substr(0, data.size() - 1), lastRecord);
+  test.corruptFile(legacy.substr(0, 10), 0);
+  test.corruptFile(legacy.substr(0, legacy.size() - 1), lastLegacyRecord);
+
+  std::cout << "Testing records files (memory budget):" << std::endl;
+
+  test.overBudget(records, 10);
+  test.overBudget(many, 1 << 20);
+  test.overBudget(many, many.size() * sizeof(NumberInfo));
+}
@@ -0,0 +1,71 @@
+#ifndef FUZZ_HPP
+#define FUZZ_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+
+/**
+	@brief Entry point of every fuzz target (libFuzzer interface).
+
+	Each fuzz target defines it. It is called by libFuzzer when the targets
+	are built with Clang, or by the standalone driver (standalone.cpp)
+	otherwise.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+/// Report a failed differential check and abort (so that the fuzzer saves the input).
+void fuzzCheck(bool condition, const std::string& message);
+
+/**
+	@class PerformanceGuard
+	@brief Detect inputs that take too long for their size.
+
+	Measures the time elapsed between construction and destruction. If it
+	exceeds a fixed allowance plus a per-byte allowance, the input is reported
+	and the process aborts. This flags performance cliffs (e.g., quadratic
+	behaviour) that would go unnoticed as long as nothing crashes. Allowances
+	can be set with the environment variables FUZZ_FIXED_BUDGET_US and
+	FUZZ_PER_BYTE_NS.
+*/
+class PerformanceGuard
+{
+public:
+	PerformanceGuard(const char* target, size_t size);
+	~PerformanceGuard();
+
+private:
+	const char* target;
+	size_t size;
+	std::chrono::steady_clock::time_point start;
+};
+
+/**
+	@class StreamRedirector
+	@brief Redirect std::cin from a string and std::cout to a string.
+
+	Redirection is made during construction and undone on destruction.
+*/
+class StreamRedirector
+{
+public:
+	StreamRedirector(const std::string& input = "");
+	~StreamRedirector();
+
+	/// Get data written to std::cout so far.
+	std::string output() const;
+
+private:
+	std::streambuf* originalCin;
+	std::streambuf* originalCout;
+	std::istringstream newCin;
+	std::ostringstream newCout;
+};
+
+/// Write data to a new temporary file with the given extension and return its path.
+std::string writeTempFile(const uint8_t* data, size_t size, const std::string& extension);
+
+#endif
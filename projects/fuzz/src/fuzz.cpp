@@ -0,0 +1,79 @@
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "async.hpp"
+#include "fuzz.hpp"
+
+namespace {
+
+long long getEnvNumber(const char *name, long long defaultValue) {
+  const char *value = std::getenv(name);
+  return value ? std::atoll(value) : defaultValue;
+}
+
+} // namespace
+
+void fuzzCheck(bool condition, const std::string &message) {
+  if (condition)
+    return;
+
+  std::cerr << "Differential check failed: " << message << std::endl;
+  std::abort();
+}
+
+PerformanceGuard::PerformanceGuard(const char *target, size_t size)
+    : target(target), size(size), start(std::chrono::steady_clock::now()) {}
+
+PerformanceGuard::~PerformanceGuard() {
+  static const long long fixedBudgetUs =
+      getEnvNumber("FUZZ_FIXED_BUDGET_US", 200000);
+  static const long long perByteNs = getEnvNumber("FUZZ_PER_BYTE_NS", 20000);
+
+  long long elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  long long budgetUs =
+      fixedBudgetUs + static_cast<long long>(size) * perByteNs / 1000;
+
+  if (elapsedUs > budgetUs) {
+    std::cerr << "Performance cliff in " << target << ": " << size
+              << " bytes took " << elapsedUs << " us (budget " << budgetUs
+              << " us)" << std::endl;
+    std::abort();
+  }
+}
+
+StreamRedirector::StreamRedirector(const std::string &input)
+    : originalCin(std::cin.rdbuf()), originalCout(std::cout.rdbuf()),
+      newCin(input) {
+  std::cin.rdbuf(newCin.rdbuf());
+  std::cout.rdbuf(newCout.rdbuf());
+  Scheduler::setStdinRedirected(true);
+}
+
+StreamRedirector::~StreamRedirector() {
+  std::cin.rdbuf(originalCin);
+  std::cout.rdbuf(originalCout);
+  Scheduler::setStdinRedirected(false);
+}
+
+std::string StreamRedirector::output() const { return newCout.str(); }
+
+std::string writeTempFile(const uint8_t *data, size_t size,
+                          const std::string &extension) {
+  static const unsigned long long processTag = std::random_device()();
+  static std::atomic<unsigned> fileCounter(0);
+
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("fuzz_" + std::to_string(processTag) + "_" +
+                       std::to_string(fileCounter++) + extension))
+                         .string();
+
+  std::ofstream file(path, std::ios_base::binary);
+  file.write(reinterpret_cast<const char *>(data), size);
+  return path;
+}
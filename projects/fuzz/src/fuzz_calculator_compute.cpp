@@ -0,0 +1,96 @@
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "calculator.hpp"
+#include "fuzz.hpp"
+
+namespace {
+
+/// Reference result of an operation (wrapping arithmetic). False if invalid.
+bool referenceCompute(long value1, long value2, long symbol, long &result) {
+  unsigned long a = static_cast<unsigned long>(value1);
+  unsigned long b = static_cast<unsigned long>(value2);
+
+  switch (symbol) {
+  case addition:
+    result = static_cast<long>(a + b);
+    return true;
+  case subtraction:
+    result = static_cast<long>(a - b);
+    return true;
+  case multiplication:
+    result = static_cast<long>(a * b);
+    return true;
+  case division:
+    if (value2 == 0 || (value2 == -1 && value1 == LONG_MIN))
+      return false;
+    result = value1 / value2;
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::string printedRecords(const Calculator &calc) {
+  StreamRedirector redirect;
+  calc.printRecords();
+  return redirect.output();
+}
+
+} // namespace
+
+/**
+	Calculator compute target. The first byte is the operator and the rest
+	are pairs of operands. computeKernel() must match the reference
+	arithmetic (or throw if any operation is invalid), and computeBatch() must
+	record the same results as calling compute() once per pair.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  PerformanceGuard guard("fuzz_calculator_compute", size);
+  if (!size)
+    return 0;
+
+  long symbol = data[0] % 6;
+  size_t pairs = (size - 1) / (2 * sizeof(long));
+  std::vector<long> values1(pairs), values2(pairs), results(pairs);
+  for (size_t i = 0; i < pairs; i++) {
+    std::memcpy(&values1[i], data + 1 + 2 * i * sizeof(long), sizeof(long));
+    std::memcpy(&values2[i], data + 1 + (2 * i + 1) * sizeof(long),
+                sizeof(long));
+  }
+
+  // Kernel against the reference.
+  std::vector<long> expected(pairs);
+  bool allValid = symbol >= addition && symbol <= division;
+  for (size_t i = 0; i < pairs; i++)
+    allValid =
+        referenceCompute(values1[i], values2[i], symbol, expected[i]) &&
+        allValid;
+
+  bool thrown = false;
+  try {
+    Calculator::computeKernel(symbol, values1, values2, results);
+  } catch (const std::invalid_argument &e) {
+    thrown = true;
+  }
+  fuzzCheck(thrown == !allValid, "computeKernel() validation differs");
+  fuzzCheck(thrown || results == expected,
+            "computeKernel() differs from the reference");
+
+  // Batch against single operations (only valid operations are recorded).
+  if (allValid) {
+    Calculator single, batch;
+    {
+      StreamRedirector redirect;
+      for (size_t i = 0; i < pairs; i++)
+        single.compute(values1[i], values2[i], symbol);
+    }
+    batch.computeBatch(symbol, values1, values2);
+    fuzzCheck(printedRecords(single) == printedRecords(batch),
+              "computeBatch() differs from compute()");
+  }
+
+  return 0;
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "calculator.hpp"
+#include "fuzz.hpp"
+#include "records_file.hpp"
+
+namespace {
+
+/// Load a calculator file and get its records as printed (the file is saved again on return).
+std::string loadRecords(const std::string &path) {
+  StreamRedirector redirect;
+  Calculator calc(path);
+  calc.printRecords();
+  return redirect.output();
+}
+
+/// Reference text loader: the original Calculator loader (one record per line).
+std::vector<NumberInfo> referenceText(const std::string &content) {
+  std::vector<NumberInfo> records;
+  std::istringstream iFile(content);
+  std::string line;
+  NumberInfo entry;
+  while (std::getline(iFile, line)) {
+    std::istringstream iss(line);
+    iss >> entry.value >> entry.parity >> entry.order;
+    std::getline(iss >> std::ws, entry.description);
+
+    records.push_back(entry);
+    entry.clear();
+  }
+  return records;
+}
+
+/// Reference binary loader for files without header: the original Calculator
+/// loader (native layout), with bounds checks. False if any record is
+/// truncated, its description doesn't fit or its parity is invalid.
+bool referenceLegacy(const std::string &content,
+                     std::vector<NumberInfo> &records) {
+  NumberInfo entry;
+  size_t strLength;
+  const size_t fixedSize = sizeof(entry.value) + sizeof(entry.parity) +
+                           sizeof(entry.order) + sizeof(strLength);
+
+  size_t offset = 0;
+  while (offset < content.size()) {
+    if (content.size() - offset < fixedSize)
+      return false;
+    const char *in = content.data() + offset;
+    std::memcpy(&entry.value, in, sizeof(entry.value));
+    in += sizeof(entry.value);
+    std::memcpy(&entry.parity, in, sizeof(entry.parity));
+    in += sizeof(entry.parity);
+    std::memcpy(&entry.order, in, sizeof(entry.order));
+    in += sizeof(entry.order);
+    std::memcpy(&strLength, in, sizeof(strLength));
+    offset += fixedSize;
+
+    if (entry.parity < Parity::any || entry.parity > Parity::even ||
+        strLength > content.size() - offset)
+      return false;
+    entry.description.assign(content, offset, strLength);
+    offset += strLength;
+
+    records.push_back(entry);
+    entry.clear();
+  }
+  return true;
+}
+
+/// Whether a file starts like the magic of the versioned format ("CALC"),
+/// possibly damaged or truncated. Such files are never read as legacy ones.
+bool startsLikeMagic(const std::string &content) {
+  const char magic[] = "CALC";
+  size_t bytes = std::min<size_t>(content.size(), 4);
+  size_t matches = 0;
+  for (size_t i = 0; i < bytes; i++)
+    matches += content[i] == magic[i];
+  return bytes && matches >= std::min<size_t>(bytes, 3);
+}
+
+/// Build a valid file without header from fuzz bytes: each record takes an
+/// 8-byte value, a parity byte, an 8-byte order, a length byte and the
+/// description.
+std::string legacyContent(const uint8_t *data, size_t size) {
+  std::string content;
+  auto take = [&](void *out, size_t bytes) {
+    std::memset(out, 0, bytes);
+    std::memcpy(out, data, std::min(bytes, size));
+    size_t used = std::min(bytes, size);
+    data += used;
+    size -= used;
+  };
+
+  while (size) {
+    long value;
+    size_t order, strLength;
+    uint8_t parity, length;
+    take(&value, sizeof(value));
+    take(&parity, 1);
+    take(&order, sizeof(order));
+    take(&length, 1);
+    int storedParity = parity % 3;
+    strLength = std::min<size_t>(length % 32, size);
+
+    content.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    content.append(reinterpret_cast<const char *>(&storedParity),
+                   sizeof(storedParity));
+    content.append(reinterpret_cast<const char *>(&order), sizeof(order));
+    content.append(reinterpret_cast<const char *>(&strLength),
+                   sizeof(strLength));
+    content.append(reinterpret_cast<const char *>(data), strLength);
+    data += strLength;
+    size -= strLength;
+  }
+  return content;
+}
+
+bool sameRecords(const std::vector<NumberInfo> &a,
+                 const std::vector<NumberInfo> &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++)
+    if (a[i].value != b[i].value || a[i].parity != b[i].parity ||
+        a[i].order != b[i].order ||
+        a[i].getDescription() != b[i].getDescription())
+      return false;
+  return true;
+}
+
+} // namespace
+
+/**
+	Calculator loader target. The first byte selects the content: a text
+	file, a binary file, or a valid binary file without header built from the
+	fuzz bytes; the rest is the content (or what it is built from).
+
+	Text files and binary files without header (the layout written before
+	the versioned format, unless they start like its magic) are compared
+	against references: bounds-checked copies of the original loaders, which
+	reject truncated or invalid binary records. Loading must not crash nor
+	allocate unbounded memory (corrupt files must be rejected with
+	std::runtime_error), and the records must survive a save/load round trip
+	unchanged (the Calculator saves its records on destruction).
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  PerformanceGuard guard("fuzz_calculator_load", size);
+  if (!size)
+    return 0;
+
+  int mode = data[0] % 3;
+  std::string extension = mode ? ".bin" : ".txt";
+  std::string content = mode == 2
+                            ? legacyContent(data + 1, size - 1)
+                            : std::string(reinterpret_cast<const char *>(data + 1),
+                                          size - 1);
+  std::string path = writeTempFile(
+      reinterpret_cast<const uint8_t *>(content.data()), content.size(),
+      extension);
+
+  // Loaders against the references.
+  std::vector<NumberInfo> loadedRecords, expectedRecords;
+  bool rejected = false;
+  try {
+    if (mode)
+      loadBinaryRecords(path, loadedRecords);
+    else
+      loadTextRecords(path, loadedRecords);
+  } catch (const std::runtime_error &e) {
+    rejected = true;
+  }
+
+  if (!mode) {
+    fuzzCheck(!rejected && sameRecords(loadedRecords, referenceText(content)),
+              "loadTextRecords() differs from the reference");
+  } else if (!startsLikeMagic(content)) {
+    bool valid = referenceLegacy(content, expectedRecords);
+    fuzzCheck(rejected == !valid,
+              "loadBinaryRecords() validation differs from the reference");
+    fuzzCheck(!valid || sameRecords(loadedRecords, expectedRecords),
+              "loadBinaryRecords() differs from the reference");
+  }
+  fuzzCheck(mode != 2 || !rejected || startsLikeMagic(content),
+            "a valid file without header was rejected");
+
+  // Round trip through the Calculator.
+  std::string loaded, reloaded;
+  try {
+    loaded = loadRecords(path);
+  } catch (const std::runtime_error &e) {
+    std::remove(path.c_str()); // Corrupt file rejected
+    return 0;
+  }
+  reloaded = loadRecords(path);
+  std::remove(path.c_str());
+
+  fuzzCheck(loaded == reloaded,
+            "records changed after saving and loading a " + extension + " file");
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <map>
+
+#include "fuzz.hpp"
+#include "words.hpp"
+
+namespace {
+
+/**
+	Reference implementation of the ingest rules (original WordsStorage code,
+	without threads): first word per line, non-alpha words discarded, stop
+	at 'end'.
+*/
+std::map<std::string, size_t> referenceIngest(const std::string &input) {
+  std::map<std::string, size_t> words;
+  std::istringstream lines(input);
+  std::string linebuf;
+
+  while (std::getline(lines, linebuf)) {
+    std::istringstream iss(linebuf);
+    iss >> linebuf;
+
+    if (linebuf == "" ||
+        !std::all_of(linebuf.begin(), linebuf.end(),
+                     [](unsigned char c) { return std::isalpha(c); }))
+      continue;
+    if (linebuf == "end")
+      break;
+    words[linebuf]++;
+  }
+
+  return words;
+}
+
+std::string referenceWordsList(const std::map<std::string, size_t> &words) {
+  std::string list("\n=== Word list:\n");
+  for (const auto &p : words)
+    list += p.first + " " + std::to_string(p.second) + "\n";
+  return list;
+}
+
+std::string printedWordsList(const WordsStorage &subject) {
+  StreamRedirector redirect;
+  subject.printWordsList();
+  return redirect.output();
+}
+
+} // namespace
+
+/**
+	Word ingest target. The input is read through readInputWords() (STDIN)
+	and readInputFiles(), and both word lists must match the reference. The
+	index is checked against the reference too.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  PerformanceGuard guard("fuzz_words", size);
+
+  // readInputWords() only returns on 'end' (it waits on EOF), so append it.
+  std::string input(reinterpret_cast<const char *>(data), size);
+  input += "\nend\n";
+
+  std::map<std::string, size_t> reference = referenceIngest(input);
+  std::string expectedList = referenceWordsList(reference);
+
+  WordsStorage fromStdin;
+  {
+    StreamRedirector redirect(input);
+    fromStdin.readInputWords();
+  }
+  fuzzCheck(printedWordsList(fromStdin) == expectedList,
+            "readInputWords() differs from the reference");
+
+  WordsStorage fromFile;
+  std::string path = writeTempFile(
+      reinterpret_cast<const uint8_t *>(input.data()), input.size(), ".txt");
+  fromFile.readInputFiles({path});
+  std::remove(path.c_str());
+  fuzzCheck(printedWordsList(fromFile) == expectedList,
+            "readInputFiles() differs from the reference");
+
+  for (const std::pair<std::string, size_t> p : reference) {
+    WordCountList exact = fromStdin.findSimilar(p.first, 0);
+    fuzzCheck(exact.size() == 1 && exact[0] == p,
+              "findSimilar(word, 0) does not return the word");
+
+    WordCountList prefixed = fromStdin.findPrefix(p.first);
+    fuzzCheck(prefixed.size() && prefixed[0] == p,
+              "findPrefix(word) does not start with the word");
+  }
+
+  return 0;
+}
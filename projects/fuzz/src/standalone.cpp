@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "fuzz.hpp"
+
+namespace {
+
+/// Run the target on a file, or on every file of a directory (corpus).
+void runPath(const std::filesystem::path &path) {
+  if (std::filesystem::is_directory(path)) {
+    for (const auto &entry : std::filesystem::directory_iterator(path))
+      runPath(entry.path());
+    return;
+  }
+
+  std::ifstream file(path, std::ios_base::binary);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+/// Generate an input biased towards the tokens the parsers care about.
+std::vector<uint8_t> randomInput(std::mt19937 &random) {
+  static const std::vector<std::string> tokens = {
+      "end", "sword", "Bow", "\n", "\n", " ", "\t", "1", "-", "0", "\xff",
+      std::string("CALC\x01\0\0\0", 8)};
+
+  std::vector<uint8_t> data;
+  size_t size = random() % (random() % 8 ? 64 : 4096);
+  while (data.size() < size) {
+    if (random() % 2)
+      data.push_back(static_cast<uint8_t>(random()));
+    else {
+      const std::string &token = tokens[random() % tokens.size()];
+      data.insert(data.end(), token.begin(), token.end());
+    }
+  }
+
+  return data;
+}
+
+} // namespace
+
+/**
+	Driver for compilers without libFuzzer. With arguments, run the target on
+	each file (or directory of files) given, like a libFuzzer binary does.
+	Without arguments, run it on FUZZ_RUNS (default 500) random inputs.
+*/
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++)
+      runPath(argv[i]);
+    return 0;
+  }
+
+  const char *runsEnv = std::getenv("FUZZ_RUNS");
+  long runs = runsEnv ? std::atol(runsEnv) : 500;
+  std::mt19937 random(12345);
+
+  for (long i = 0; i < runs; i++) {
+    std::vector<uint8_t> data = randomInput(random);
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+  }
+
+  std::cout << "Executed " << runs << " inputs" << std::endl;
+  return 0;
+}
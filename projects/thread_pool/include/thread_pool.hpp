@@ -0,0 +1,230 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+	@class ThreadPool
+	@brief Work-stealing task scheduler.
+
+	Each worker thread has its own deque of tasks. A worker pushes and pops
+	the tasks it creates at the back of its deque (newest first, which keeps
+	their data in cache), and when its deque is empty it steals the oldest
+	task from the front of another deque. Tasks submitted from other threads
+	go to a shared deque that workers also steal from. Idle workers sleep
+	until new tasks arrive.
+
+	Threads waiting for tasks (see TaskGroup::wait()) run queued tasks
+	meanwhile, so nested parallelism (tasks that wait for other tasks) never
+	deadlocks and the calling thread counts as one more worker.
+
+	Tasks submitted directly must not throw; use TaskGroup to get their
+	exceptions.
+*/
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	/// Use 'numThreads' threads ('numThreads' - 1 workers plus the waiting thread). 0 uses all the hardware threads.
+	explicit ThreadPool(unsigned numThreads = 0);
+
+	/// Run the remaining tasks and stop the workers.
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// Pool shared by the whole process (created on first use with all the hardware threads).
+	static ThreadPool& global();
+
+	/// Number of threads of a pool created with 0 threads, like the global one (without creating it).
+	static unsigned defaultNumThreads();
+
+	/// Number of threads running tasks (workers plus the waiting thread).
+	unsigned numThreads() const;
+
+	/// Queue a task (in the deque of the calling worker, or in the shared deque).
+	void submit(Task task);
+
+	/// Queue several tasks at once, taking one lock and waking up the workers once.
+	void submit(std::vector<Task>& tasks);
+
+	/// Run one queued task on the calling thread. Return false if there was none.
+	bool runOne();
+
+private:
+	/// Deque of tasks. Its owner uses the back and thieves use the front.
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> m_queues; /// One per worker, plus the shared one (last)
+	std::vector<std::thread> m_workers;
+	std::atomic<size_t> m_queued; /// Tasks in all the deques
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeUp; /// Signaled when tasks are queued or on stop
+	bool m_stop;
+
+	void workerLoop(size_t index);
+
+	/// Get the deque of the calling thread (its own if it is a worker of this pool).
+	size_t queueIndex() const;
+
+	/// Take a task: from the back of deque 'index', or else from the front of the others.
+	bool popTask(size_t index, Task& task);
+
+	/// Wake up workers after queueing 'count' tasks.
+	void notify(size_t count);
+};
+
+/**
+	@class TaskGroup
+	@brief Set of tasks that can be waited for together (fork-join).
+
+	Tasks run on a ThreadPool. wait() returns when all of them have finished
+	and rethrows the first exception thrown by any of them. Once a task has
+	thrown, the tasks of the group that haven't started yet are skipped.
+*/
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& pool = ThreadPool::global());
+
+	/// Wait for the pending tasks (their exceptions are ignored).
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	/// Run a task in the pool.
+	void run(std::function<void()> task);
+
+	/// Run several tasks in the pool, queued together (batch).
+	void run(std::vector<std::function<void()>> tasks);
+
+	/// Wait for all the tasks, running queued tasks meanwhile. Rethrows the first exception.
+	void wait();
+
+private:
+	ThreadPool& m_pool;
+	std::atomic<size_t> m_pending; /// Tasks not finished yet
+	std::atomic<bool> m_failed; /// Whether a task has thrown
+	std::exception_ptr m_error; /// First exception thrown
+	std::mutex m_mutex; /// Protects 'm_error' and the end of each task
+	std::condition_variable m_done; /// Signaled when no task is pending
+
+	/// Wrap a task so that it records its exception and its end.
+	ThreadPool::Task wrap(std::function<void()> task);
+};
+
+/// Iterations per chunk used when no grain is given: about 4 chunks per thread, for load balancing.
+inline size_t defaultGrain(size_t size, unsigned numThreads = ThreadPool::defaultNumThreads())
+{
+	return std::max<size_t>(1, size / (4 * numThreads));
+}
+
+/**
+	@brief Call 'body(chunkBegin, chunkEnd)' in parallel over [begin, end).
+
+	The range is split into chunks of 'grain' iterations (the last one may be
+	shorter), so that each task does enough work to pay for its scheduling
+	(task batching). The chunk of an iteration i is (i - begin) / grain.
+	'grain' = 0 uses defaultGrain(). Returns when all the chunks are done and
+	rethrows the first exception thrown by 'body'.
+*/
+template <class Body>
+void parallelFor(size_t begin, size_t end, Body body, size_t grain, ThreadPool& pool)
+{
+	if (begin >= end) return;
+	if (!grain) grain = defaultGrain(end - begin, pool.numThreads());
+
+	if (grain >= end - begin)   // Not worth a task
+	{
+		body(begin, end);
+		return;
+	}
+
+	std::vector<std::function<void()>> tasks;
+	tasks.reserve((end - begin - 1) / grain + 1);
+	for (size_t chunk = begin, chunkEnd; chunk < end; chunk = chunkEnd)
+	{
+		chunkEnd = chunk + std::min(grain, end - chunk);
+		tasks.push_back([&body, chunk, chunkEnd] { body(chunk, chunkEnd); });
+	}
+
+	TaskGroup group(pool);
+	group.run(std::move(tasks));
+	group.wait();
+}
+
+/// parallelFor() on the global ThreadPool. A range that fits in one chunk runs on the calling thread without creating the pool.
+template <class Body>
+void parallelFor(size_t begin, size_t end, Body body, size_t grain = 0)
+{
+	if (begin >= end) return;
+	if (!grain) grain = defaultGrain(end - begin);
+
+	if (grain >= end - begin)
+	{
+		body(begin, end);
+		return;
+	}
+
+	parallelFor(begin, end, std::move(body), grain, ThreadPool::global());
+}
+
+/**
+	@brief Map chunks of [begin, end) in parallel and combine their results.
+
+	Each chunk (see parallelFor()) is mapped with 'map(chunkBegin, chunkEnd)'
+	to a T, and the results are combined with 'reduce(T, T)' in the order of
+	the chunks, starting with 'identity'. 'reduce' must be associative, but
+	it doesn't need to be commutative.
+*/
+template <class T, class Map, class Reduce>
+T parallelReduce(size_t begin, size_t end, T identity, Map map, Reduce reduce,
+                 size_t grain, ThreadPool& pool)
+{
+	if (begin >= end) return identity;
+	if (!grain) grain = defaultGrain(end - begin, pool.numThreads());
+
+	std::vector<T> partial((end - begin - 1) / grain + 1, identity);
+	parallelFor(begin, end, [&](size_t chunkBegin, size_t chunkEnd)
+	{
+		partial[(chunkBegin - begin) / grain] = map(chunkBegin, chunkEnd);
+	}, grain, pool);
+
+	T result = std::move(identity);
+	for (T& p : partial)
+		result = reduce(std::move(result), std::move(p));
+	return result;
+}
+
+/// parallelReduce() on the global ThreadPool. A range that fits in one chunk runs on the calling thread without creating the pool.
+template <class T, class Map, class Reduce>
+T parallelReduce(size_t begin, size_t end, T identity, Map map, Reduce reduce,
+                 size_t grain = 0)
+{
+	if (begin >= end) return identity;
+	if (!grain) grain = defaultGrain(end - begin);
+
+	if (grain >= end - begin)
+		return reduce(std::move(identity), map(begin, end));
+
+	return parallelReduce(begin, end, std::move(identity), std::move(map),
+	                      std::move(reduce), grain, ThreadPool::global());
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include <chrono>
+
+#include "thread_pool.hpp"
+
+namespace {
+
+/// Pool of the calling thread (nullptr if it is not a worker) and its deque.
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+/// Times a waiting thread looks for tasks before sleeping.
+const int waitSpins = 64;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned numThreads) : m_queued(0), m_stop(false) {
+  if (!numThreads)
+    numThreads = defaultNumThreads();
+
+  for (unsigned i = 0; i < numThreads; i++)
+    m_queues.push_back(std::make_unique<Queue>());
+
+  for (unsigned i = 0; i + 1 < numThreads; i++)
+    m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_stop = true;
+  }
+  m_wakeUp.notify_all();
+
+  for (auto &worker : m_workers)
+    worker.join();
+
+  // Without workers, nobody ran the tasks that weren't waited for.
+  Task task;
+  while (popTask(m_queues.size() - 1, task))
+    task();
+}
+
+ThreadPool &ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+unsigned ThreadPool::defaultNumThreads() {
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+unsigned ThreadPool::numThreads() const {
+  return static_cast<unsigned>(m_workers.size() + 1);
+}
+
+void ThreadPool::submit(Task task) {
+  Queue &queue = *m_queues[queueIndex()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    ++m_queued; // Before the task is visible, so it's never undercounted
+    queue.tasks.push_back(std::move(task));
+  }
+  notify(1);
+}
+
+void ThreadPool::submit(std::vector<Task> &tasks) {
+  if (tasks.empty())
+    return;
+
+  Queue &queue = *m_queues[queueIndex()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    m_queued += tasks.size();
+    for (auto &task : tasks)
+      queue.tasks.push_back(std::move(task));
+  }
+  notify(tasks.size());
+  tasks.clear();
+}
+
+bool ThreadPool::runOne() {
+  Task task;
+  if (!popTask(queueIndex(), task))
+    return false;
+
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+  currentPool = this;
+  currentQueue = index;
+
+  Task task;
+  for (;;) {
+    if (popTask(index, task)) {
+      task();
+      task = nullptr; // Release what the task holds before sleeping
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wakeUp.wait(lock, [this] { return m_stop || m_queued > 0; });
+    if (m_stop && !m_queued)
+      return;
+  }
+}
+
+size_t ThreadPool::queueIndex() const {
+  return currentPool == this ? currentQueue : m_queues.size() - 1;
+}
+
+bool ThreadPool::popTask(size_t index, Task &task) {
+  if (!m_queued)
+    return false;
+
+  // Own deque: newest task first.
+  {
+    Queue &queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.size()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      --m_queued;
+      return true;
+    }
+  }
+
+  // Steal the oldest task of another deque.
+  for (size_t i = 1; i < m_queues.size(); i++) {
+    Queue &queue = *m_queues[(index + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.size()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --m_queued;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::notify(size_t count) {
+  if (m_workers.empty())
+    return;
+
+  // Taking the lock ensures that no worker is between checking for tasks and
+  // sleeping, which would miss the notification.
+  { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+  if (count == 1)
+    m_wakeUp.notify_one();
+  else
+    m_wakeUp.notify_all();
+}
+
+TaskGroup::TaskGroup(ThreadPool &pool)
+    : m_pool(pool), m_pending(0), m_failed(false) {}
+
+TaskGroup::~TaskGroup() {
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+  ++m_pending;
+  m_pool.submit(wrap(std::move(task)));
+}
+
+void TaskGroup::run(std::vector<std::function<void()>> tasks) {
+  std::vector<ThreadPool::Task> wrapped;
+  wrapped.reserve(tasks.size());
+  for (auto &task : tasks)
+    wrapped.push_back(wrap(std::move(task)));
+
+  m_pending += wrapped.size();
+  m_pool.submit(wrapped);
+}
+
+void TaskGroup::wait() {
+  int spins = 0;
+  while (m_pending) {
+    // Help with the queued tasks (of this group or not).
+    if (m_pool.runOne()) {
+      spins = 0;
+      continue;
+    }
+
+    if (++spins < waitSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // The remaining tasks are running in other threads. Sleep a little
+    // (they may queue new tasks that this thread could run).
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait_for(lock, std::chrono::milliseconds(1),
+                    [this] { return !m_pending; });
+    spins = 0;
+  }
+
+  // The last task may still be releasing the lock.
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    m_failed = false;
+    std::rethrow_exception(error);
+  }
+}
+
+ThreadPool::Task TaskGroup::wrap(std::function<void()> task) {
+  return [this, task = std::move(task)] {
+    if (!m_failed) {
+      try {
+        task();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error)
+          m_error = std::current_exception();
+        m_failed = true;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!--m_pending)
+      m_done.notify_all();
+  };
+}
@@ -0,0 +1,49 @@
+#ifndef TESTS_THREAD_POOL_HPP
+#define TESTS_THREAD_POOL_HPP
+
+#include <iostream>
+
+#include "thread_pool.hpp"
+
+/// Tests for ThreadPool, parallelFor and parallelReduce.
+void tests();
+
+/**
+	@class Test_ThreadPool
+	@brief Tool for testing ThreadPool and the parallel algorithms.
+
+	Class for creating unit tests for ThreadPool, TaskGroup, parallelFor and
+	parallelReduce.
+*/
+class Test_ThreadPool
+{
+public:
+	Test_ThreadPool();
+
+	/**
+		@brief Test that small ranges don't create the global pool.
+
+		parallelFor and parallelReduce (on the global pool) over 'size'
+		iterations in chunks of 'grain' must run on the calling thread,
+		without starting any thread (checked on Linux only). Must run before
+		anything uses the global pool.
+	*/
+	bool sequentialRange(size_t size, size_t grain);
+
+	/**
+		@brief Test ThreadPool with 'numThreads' threads.
+
+		parallelReduce and nested parallelFor over 'size' iterations must match
+		a sequential computation, and exceptions thrown by the tasks must reach
+		the waiting thread.
+	*/
+	bool parallelWork(size_t size, unsigned numThreads);
+
+private:
+	size_t testsCount;
+
+	void printOk();
+	void printFail();
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+
+#include "tests.hpp"
+
+namespace {
+
+/// Number of threads of the process (0 if unknown).
+size_t processThreads() {
+#if defined(__linux__)
+  std::error_code error;
+  std::filesystem::directory_iterator tasks("/proc/self/task", error);
+  if (!error)
+    return std::distance(tasks, std::filesystem::directory_iterator());
+#endif
+  return 0;
+}
+
+} // namespace
+
+Test_ThreadPool::Test_ThreadPool() : testsCount(0) {}
+
+bool Test_ThreadPool::sequentialRange(size_t size, size_t grain) {
+  testsCount++;
+
+  // Arrange (setup)
+  size_t threadsBefore = processThreads();
+  std::thread::id caller = std::this_thread::get_id();
+  bool sameThread = true;
+
+  // Act (execution)
+  size_t iterations = 0;
+  parallelFor(
+      0, size,
+      [&](size_t first, size_t last) {
+        sameThread = sameThread && std::this_thread::get_id() == caller;
+        iterations += last - first;
+      },
+      grain);
+
+  size_t sum = parallelReduce(
+      size_t(0), size, size_t(0),
+      [&](size_t first, size_t last) {
+        sameThread = sameThread && std::this_thread::get_id() == caller;
+        return last - first;
+      },
+      [](size_t a, size_t b) { return a + b; }, grain);
+
+  // Assert (verification)
+  if (iterations == size && sum == size && sameThread &&
+      processThreads() == threadsBefore) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_ThreadPool::parallelWork(size_t size, unsigned numThreads) {
+  testsCount++;
+
+  // Arrange (setup)
+  ThreadPool pool(numThreads);
+  std::vector<uint64_t> values(size);
+  for (size_t i = 0; i < size; i++)
+    values[i] = i * i % 1000;
+  uint64_t expected = 0;
+  for (uint64_t v : values)
+    expected += v;
+
+  // Act (execution)
+  uint64_t sum = parallelReduce(
+      size_t(0), size, uint64_t(0),
+      [&](size_t first, size_t last) {
+        uint64_t partial = 0;
+        for (size_t i = first; i < last; i++)
+          partial += values[i];
+        return partial;
+      },
+      [](uint64_t a, uint64_t b) { return a + b; }, 0, pool);
+
+  // Every row is processed by tasks nested in the task of the row.
+  std::vector<std::atomic<size_t>> rows(16);
+  parallelFor(
+      0, rows.size(),
+      [&](size_t first, size_t last) {
+        for (size_t row = first; row < last; row++)
+          parallelFor(
+              0, size,
+              [&](size_t begin, size_t end) { rows[row] += end - begin; }, 0,
+              pool);
+      },
+      1, pool);
+
+  bool thrown = false;
+  try {
+    parallelFor(
+        0, size,
+        [](size_t first, size_t) {
+          if (first == 0)
+            throw std::runtime_error("Task failure");
+        },
+        1, pool);
+  } catch (const std::runtime_error &e) {
+    thrown = true;
+  }
+
+  // Assert (verification)
+  bool failed = sum != expected || (size && !thrown);
+  for (const auto &row : rows)
+    failed = failed || row != size;
+
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
+void Test_ThreadPool::printOk() {
+  std::cout << "OK - Test " << testsCount << std::endl;
+}
+
+void Test_ThreadPool::printFail() {
+  std::cout << "FAIL - Test " << testsCount << std::endl;
+}
+
+void tests() {
+  Test_ThreadPool test;
+
+  std::cout << "Testing parallelFor() and parallelReduce() (sequential):"
+            << std::endl;
+
+  test.sequentialRange(0, 0);
+  test.sequentialRange(1, 0);
+  test.sequentialRange(1, 1);
+  test.sequentialRange(1000, 1 << 16);
+
+  std::cout << "Testing ThreadPool:" << std::endl;
+
+  test.parallelWork(0, 4);
+  test.parallelWork(1, 1);
+  test.parallelWork(1000, 1);
+  test.parallelWork(100000, 3);
+  test.parallelWork(100000, 8);
+}
@@ -0,0 +1,87 @@
+#ifndef SHARED_WORDS_HPP
+#define SHARED_WORDS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "words_index.hpp"
+
+/**
+	@class SharedWords
+	@brief Read-only vocabulary in POSIX shared memory.
+
+	A finished vocabulary is published once and then attached by any number
+	of processes, which query it in place (zero copy) instead of reading the
+	words again. The segment has no pointers, only offsets from its start:
+	a header, a table of entries (word, occurrences), an open-addressing hash
+	table (linear probing, at most half full) of entry indices for exact
+	lookups, the WordsIndex trie for prefix and similarity queries, and the
+	characters of the words.
+
+	Each publication is a new version stored in its own segment
+	("<name>.<version>"). A small control segment ("<name>") holds the
+	current version, which is swapped atomically once the new segment is
+	complete, so readers never see a partially written vocabulary. Readers
+	keep using the version they attached until they call refresh(), even if
+	the writer has unlinked it (mappings outlive unlinked segments).
+
+	Only one writer may publish a given name at a time. Shared memory is only
+	available on POSIX systems; elsewhere, these functions throw.
+*/
+class SharedWords
+{
+public:
+	/// Attach to the current version published with 'name'. Throws if there is none.
+	explicit SharedWords(const std::string& name);
+	~SharedWords();
+
+	SharedWords(const SharedWords&) = delete;
+	SharedWords& operator=(const SharedWords&) = delete;
+
+	/**
+		@brief Publish the words of an index as a new version of 'name'.
+
+		The previous version is unlinked (processes still attached to it can
+		keep using it). Return the number of the new version.
+	*/
+	static uint64_t publish(const std::string& name, const WordsIndex& index);
+
+	/// Remove the published vocabulary (control and current version segments).
+	static void remove(const std::string& name);
+
+	/// Switch to the current version if a newer one was published. Return whether it changed.
+	bool refresh();
+
+	/// Get the number of the attached version.
+	uint64_t version() const;
+
+	/// Get the number of words.
+	size_t size() const;
+
+	/// Get the occurrences of a word (0 if not present).
+	size_t count(const std::string& word) const;
+
+	/// Get the trie of the attached version (valid until refresh() changes it).
+	const WordsIndex& index() const { return m_index; }
+
+private:
+	struct Header;
+	struct Entry;
+	struct Control;
+
+	std::string m_name; /// Name of the control segment (starting with '/')
+	const Control* m_control; /// Mapped control segment
+	const char* m_data; /// Mapped segment of the attached version
+	size_t m_dataSize; /// Size of 'm_data'
+	WordsIndex m_index; /// Trie of the attached version
+
+	/// Map the current version (retrying if it is swapped while opening it).
+	void attachCurrent();
+
+	/// Unmap the attached version.
+	void detach();
+
+	const Header& header() const;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef WORD_SORT_HPP
+#define WORD_SORT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "words_index.hpp"
+
+/**
+	@brief Sort a range using several threads.
+
+	The range is split into 'numChunks' chunks, each chunk is sorted with
+	std::sort in its own task, and then the chunks are merged pairwise (also
+	in parallel) with std::inplace_merge. Tasks run on the global ThreadPool.
+	Small ranges are sorted in the calling thread. 'numChunks' = 0 uses one
+	chunk per thread of the pool.
+*/
+template <class Iter, class Compare>
+void parallelSort(Iter begin, Iter end, Compare comp, unsigned numChunks = 0)
+{
+	const size_t minChunk = 4096;
+	size_t size = end - begin;
+
+	if (!numChunks)
+		numChunks = ThreadPool::defaultNumThreads();
+	size_t chunks = std::min<size_t>(numChunks, size / minChunk);
+
+	if (chunks <= 1)
+	{
+		std::sort(begin, end, comp);
+		return;
+	}
+
+	std::vector<Iter> bounds(chunks + 1);
+	for (size_t i = 0; i <= chunks; i++)
+		bounds[i] = begin + size * i / chunks;
+
+	parallelFor(0, chunks, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+			std::sort(bounds[i], bounds[i + 1], comp);
+	}, 1);
+
+	for (size_t width = 1; width < chunks; width *= 2)
+	{
+		size_t merges = (chunks - width + 2 * width - 1) / (2 * width);
+		parallelFor(0, merges, [&](size_t first, size_t last)
+		{
+			for (size_t m = first; m < last; m++)
+			{
+				size_t i = 2 * width * m;
+				std::inplace_merge(bounds[i], bounds[i + width],
+				                   bounds[std::min(i + 2 * width, chunks)], comp);
+			}
+		}, 1);
+	}
+}
+
+/// Sort (word, occurrences) pairs by word in byte order using several threads.
+void sortWordCounts(WordCountList& words, unsigned numChunks = 0);
+
+/**
+	@class WordRunWriter
+	@brief Write a sorted run of (word, occurrences) pairs to a binary file.
+
+	Run file format (portable, little-endian): the magic "WRUN", a 32-bit
+	version, and then one record per word: 32-bit word length, the word bytes
+	and a 64-bit number of occurrences. Words must be written in increasing
+	byte order, without repetitions.
+*/
+class WordRunWriter
+{
+public:
+	/// Create (or truncate) the run file. Throws if it cannot be opened.
+	WordRunWriter(const std::string& path);
+
+	/// Append a word. Throws if words are not strictly increasing or 'count' is 0.
+	void write(const std::string& word, size_t count);
+
+	/// Flush and close the file. Throws if any write failed.
+	void close();
+
+private:
+	std::vector<char> m_buffer; /// Block buffer for the file (outlives m_file)
+	std::ofstream m_file;
+	std::string m_path;
+	std::string m_lastWord; /// Used for checking the order of the words
+	bool m_empty; /// Whether no word has been written yet
+};
+
+/**
+	@class WordRunReader
+	@brief Read a run file created with WordRunWriter.
+
+	Records are read in large blocks. Each record is validated against the file
+	size, the sorting order and a non-zero count, and corruption is reported with an exception
+	containing the file offset of the bad record.
+*/
+class WordRunReader
+{
+public:
+	/// Open a run file and check its header. Throws if invalid.
+	WordRunReader(const std::string& path);
+
+	/// Read the next record. Return false at the end of the file.
+	bool next(std::string& word, size_t& count);
+
+private:
+	std::vector<char> m_buffer; /// Block buffer for the file (outlives m_file)
+	std::ifstream m_file;
+	std::string m_path;
+	uint64_t m_fileSize;
+	uint64_t m_offset; /// Offset of the next record
+	std::string m_lastWord; /// Used for checking the order of the words
+
+	/// Throw an exception describing corruption at the current offset.
+	void corrupt(const std::string& reason) const;
+};
+
+/// Maximum number of run files merged (open) at once by default.
+const size_t defaultMaxFanIn = 64;
+
+/// Get a new path for a temporary run file in 'tempDir' (empty: the system temporary directory).
+std::string newRunPath(const std::string& tempDir = "");
+
+/**
+	@brief K-way merge of several run files.
+
+	Call 'visit' once per distinct word, in increasing byte order, with the sum
+	of its occurrences in all the runs. Only one record per open run is kept
+	in memory at a time. At most 'maxFanIn' runs are open at once: with more
+	runs, groups of 'maxFanIn' runs are first merged into intermediate run
+	files in 'tempDir' (multi-pass merge), which are removed at the end.
+*/
+void mergeWordRuns(const std::vector<std::string>& runPaths, const WordVisitor& visit,
+                   size_t maxFanIn = defaultMaxFanIn, const std::string& tempDir = "");
+
+/**
+	@class ExternalWordSorter
+	@brief Sort and count a stream of words using a bounded amount of memory.
+
+	Words are accumulated in memory. When the memory budget is exceeded, the
+	buffer is sorted (in parallel), repeated words are combined, and the result
+	is spilled as a run file to a temporary directory. In the end, all the runs
+	and the remaining buffer are merged and streamed in sorted order. Run files
+	are removed on destruction.
+*/
+class ExternalWordSorter
+{
+public:
+	/// 'memoryBudget' is in bytes. Empty 'tempDir' uses the system temporary directory.
+	ExternalWordSorter(size_t memoryBudget = 64 << 20, std::string tempDir = "");
+	~ExternalWordSorter();
+
+	ExternalWordSorter(const ExternalWordSorter&) = delete;
+	ExternalWordSorter& operator=(const ExternalWordSorter&) = delete;
+
+	/// Add occurrences of a word.
+	void add(std::string word, size_t count = 1);
+
+	/// Stream all the words added (sorted, with summed occurrences) to 'visit'.
+	void merge(const WordVisitor& visit);
+
+	/// Number of run files spilled to disk so far.
+	size_t numRuns() const;
+
+	/// Write the buffered words as a new run file now (if there are any).
+	void flush();
+
+private:
+	WordCountList m_buffer; /// Words not spilled yet
+	size_t m_bufferBytes; /// Approximate memory used by 'm_buffer'
+	size_t m_memoryBudget;
+	std::string m_tempDir;
+	std::vector<std::string> m_runs; /// Paths of the spilled runs
+
+	/// Sort the buffer and combine repeated words.
+	void sortBuffer();
+
+	/// Write the buffer as a new run file and clear it.
+	void spill();
+};
+
+#endif
@@ -1,12 +1,16 @@
 #ifndef WORDS_HPP
 #define WORDS_HPP
 
-#include <map>
-#include <mutex>
-#include <queue>
+#include <memory>
 #include <string>
-#include <thread>
-#include <condition_variable>
+#include <vector>
+#include <unordered_map>
+
+#include "async.hpp"
+#include "shared_words.hpp"
+#include "words_index.hpp"
+
+class ExternalWordSorter;
 
 /**
 	@class WordsStorage 
@@ -24,31 +28,139 @@ public:
 	WordsStorage();
 	~WordsStorage();
 
+	/**
+		@brief Limit the memory used by the stored words.
+
+		When the stored words, plus the index that would be built over them
+		(sorted pointers and at most one trie node per character), exceed
+		about 'bytes' while reading words, they are sorted and moved to run
+		files in the temporary directory (see
+		ExternalWordSorter). From then on, the word list is kept on disk:
+		printWordsList() and exportCounts() stream the merged runs, and the
+		queries that need the words in memory (lookups, prefix and similarity
+		queries, publishShared()) throw std::logic_error. 0 means no limit
+		(default).
+	*/
+	void setMemoryBudget(size_t bytes);
+
+	/// Whether the words exceeded the memory budget and are kept on disk.
+	bool isSpilled() const;
+
 	/**
 		@brief Stores words passed by the user through STDIN.
 
-		Read input words from STDIN and pass them to the worker thread for
+		Read input words from STDIN and pass them to the storage stage for
 		inclusion in the word list (storage). Passing the word 'end' will
 		terminate the process. Only the first word entered in a line is taken.
 		Empty words and words with non-letter characters are discarded. Entering
-		EOF will terminate with an exception.
+		EOF will terminate with an exception. The prefix/fuzzy index is rebuilt
+		once all the words have been stored.
+
+		Reading and storing are coroutines (pipeline stages) run by a Scheduler
+		on the calling thread and connected by a bounded Channel. The reader
+		only blocks (on epoll) when STDIN has no buffered data and the storage
+		stage has nothing left to do.
 	*/
 	void readInputWords();
 
+	/**
+		@brief Stores words read from several files in parallel.
+
+		Directories are replaced with the regular files they contain. Files are
+		read in parallel (parallelFor() on the global ThreadPool) with the same
+		rules as readInputWords(): only the first word of each line is taken,
+		empty words and words with non-letter characters are discarded, and the
+		word 'end' stops reading that file (only). Each chunk of files is
+		counted locally and the counts are merged into storage at the end.
+		Throws if any file cannot be read; storage is then left unchanged.
+	*/
+	void readInputFiles(const std::vector<std::string>& paths);
+
+	/**
+		@brief Stores the words and occurrences of several count files.
+
+		Count files are created with exportCounts() or mergeCountFiles(). They
+		are k-way merged (see mergeWordRuns()) into a temporary table, and
+		their occurrences are added to storage (spilling, if over the memory
+		budget) only if all of them were read. Throws if a file cannot be read
+		or is corrupt; storage is then left unchanged.
+	*/
+	void readCountFiles(const std::vector<std::string>& paths);
+
+	/**
+		@brief Save all words and occurrences to a count file.
+
+		The count file is a sorted binary run (see WordRunWriter), so count
+		files from different machines or shards can be combined with
+		mergeCountFiles() or readCountFiles() without re-reading the text.
+		The file is replaced only once it is complete.
+	*/
+	void exportCounts(const std::string& path) const;
+
+	/**
+		@brief Combine several count files into one.
+
+		K-way merge of the input count files into a new count file, adding the
+		occurrences of repeated words. Only one record per open file is kept in
+		memory at a time, and at most defaultMaxFanIn files are open at once
+		(see mergeWordRuns()), so any number of words and files can be merged.
+		The output is written to a temporary file in its directory and renamed
+		when complete, so it can be one of the inputs (merging in place), and
+		a failed merge leaves it unchanged.
+	*/
+	static void mergeCountFiles(const std::vector<std::string>& inputs,
+	                            const std::string& output);
+
+	/**
+		@brief Publish the stored words in shared memory (see SharedWords).
+
+		Other processes can then use them with attachShared() without reading
+		the words again. Publishing again with the same name replaces the
+		vocabulary atomically, without disturbing the processes using it.
+	*/
+	void publishShared(const std::string& name) const;
+
+	/**
+		@brief Use the words published in shared memory with 'name'.
+
+		From now on, lookups, prefix and similarity queries, and the word list
+		use the shared vocabulary in place (zero copy) instead of the words
+		stored locally. Before each lookup in lookupWords(), it switches to the
+		latest published version. Throws if nothing was published.
+	*/
+	void attachShared(const std::string& name);
+
 	/**
 		@brief Allows the user search for words in storage and its occurrences.
 
 		Repeatedly ask the user for a word and check whether it is present in
-		storage. Entering EOF (Ctrl+D on Linux, Ctrl+Z on Windows) will
-		terminate the process.
+		storage. If it is not, words at edit distance 1 are suggested (unless it
+		is longer than maxSuggestionLength characters). A word
+		ending in '*' (e.g., "sw*") lists all the words starting with the
+		preceding prefix. Entering EOF (Ctrl+D on Linux, Ctrl+Z on Windows)
+		will terminate the process.
+
+		Like readInputWords(), it runs as a pipeline of coroutines: reading
+		lines, looking them up, and writing the answers. Output is flushed
+		whenever the writer has nothing else to write, so prompts are visible
+		before waiting for input.
 	*/
 	void lookupWords();
+
+	/// Get all words starting with a prefix, sorted, with their occurrences.
+	WordCountList findPrefix(const std::string& prefix) const;
+
+	/// Get all words within 'maxDistance' edits of a word, with their occurrences.
+	WordCountList findSimilar(const std::string& word, size_t maxDistance = 1) const;
         
         /**
           @brief Print all words sorted together with the number of occurrences.
         
           Print all words sorted together with the number of occurrences. Sorting is done
           alphabetically. First, uppercase letters; second, lowercase letters.
+          Words are streamed in order from the index built after ingest, or
+          merged from the run files if they exceeded the memory budget, so no
+          sorted copy of the vocabulary is made.
         */
 	void printWordsList() const;
 
@@ -56,21 +168,47 @@ public:
 	void printWordsFound() const;
 
 private:
-	std::map<std::string, size_t> m_wordsArray; /// Words and occurrences
-	std::queue<std::string> m_words; /// Shared staging variable for new words
+	std::unordered_map<std::string, size_t> m_wordsArray; /// Words and occurrences
+	WordsIndex m_index; /// Sorted prefix/fuzzy index over 'm_wordsArray'
 	size_t m_totalFound; /// Total number of words found in 'lookupWords()'
+	std::unique_ptr<SharedWords> m_shared; /// Attached shared vocabulary (if any)
+	size_t m_memoryBudget; /// Limit for 'm_wordsArray' and 'm_index' in bytes (0: none)
+	size_t m_wordsBytes; /// Approximate memory used by 'm_wordsArray' and its future index
+	std::unique_ptr<ExternalWordSorter> m_spilled; /// Words moved to disk (if any)
+
+	/// Words longer than this get no suggestions when they are not found.
+	static const size_t maxSuggestionLength = 256;
 
-	std::mutex m_mtxWord; /// Controls access to 'm_word'
-	std::condition_variable m_condVar; /// Wake up/sleep the worker thread
+	/// Maximum number of items waiting between two pipeline stages.
+	static const size_t pipelineCapacity = 1024;
 
 	/**
-		@brief Worker thread for saving words in storage.
+		@brief Pipeline stage that reads words from STDIN.
 
-		Thread that gets a word (temporarily stored in 'm_word') and saves it
-		in storage ('m_wordsArray'). Encountering the word 'end' will terminate
-		the process.
+		Read lines until the word 'end' and push their valid words to 'words'.
+		The channel is closed when finishing (also when throwing), so that the
+		storage stage can store the words already read. Stops if the storage
+		stage closes it.
 	*/
-	void workerThread();
+	Task readWordsStage(Scheduler& scheduler, Channel<std::string>& words);
+
+	/// Pipeline stage that saves the words received in storage ('m_wordsArray').
+	/// If storing fails, it closes 'words' so that the read stage stops.
+	Task storeWordsStage(Channel<std::string>& words);
+
+	/// Pipeline stage that reads lines from STDIN until EOF (or until the lookup
+	/// stage closes 'lines').
+	Task readLinesStage(Scheduler& scheduler, Channel<std::string>& lines);
+
+	/// Pipeline stage that looks up each line received and outputs the answer.
+	/// If a lookup fails, it closes both channels so that the other stages stop.
+	Task lookupStage(Channel<std::string>& lines, Channel<std::string>& output);
+
+	/// Pipeline stage that writes to STDOUT, flushing when idle.
+	Task writeStage(Channel<std::string>& output);
+
+	/// Get the answer to a lookup line (word, or prefix followed by '*').
+	std::string lookupLine(const std::string& line);
 
 	/**
 		@brief Handle cin errors like EOF.
@@ -81,9 +219,39 @@ private:
 	*/
 	void handleCinError() const;
 
-	/// Finish worker thread safely.
-	void finishWorker(std::thread& worker);
-	
+	/// Add occurrences of a word to storage, spilling it if over the budget.
+	void storeWord(const std::string& word, size_t count);
+
+	/// Move the words of 'm_wordsArray' to run files (see setMemoryBudget()).
+	void spillWords();
+
+	/// Throw if the words are kept on disk (see setMemoryBudget()).
+	void checkInMemory() const;
+
+	/// Sort the stored words (in parallel) and rebuild 'm_index' from them.
+	void rebuildIndex();
+
+	/// Get the index in use ('m_index', or the one of the shared vocabulary).
+	const WordsIndex& index() const;
+
+	/// Get the occurrences of a word in the vocabulary in use (0 if not present).
+	size_t countOf(const std::string& word) const;
+
+	/// Get the suggestions for a word that was not found ("" if none).
+	std::string formatSuggestions(const WordCountList& suggestions) const;
+
+	/**
+		@brief Get the word of a line that will be stored.
+
+		Get the first word of a line. Return false if the line has no words or
+		the word contains non-letter characters.
+	*/
+	bool extractWord(const std::string& line, std::string& word);
+
+	/// Count the words of a file (see readInputFiles()) into 'counts'.
+	void countFileWords(const std::string& path,
+	                    std::unordered_map<std::string, size_t>& counts);
+
 	/// Check whether a string only contains letters (alpha characters).
 	bool isAllAlpha(const std::string& str);
 };
@@ -0,0 +1,115 @@
+#ifndef WORDS_INDEX_HPP
+#define WORDS_INDEX_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// List of (word, occurrences) pairs returned by WordsIndex queries.
+typedef std::vector<std::pair<std::string, size_t>> WordCountList;
+
+/// Stored word and its occurrences.
+typedef std::pair<const std::string, size_t> WordEntry;
+
+/// Callback receiving words (and occurrences) in sorted order.
+typedef std::function<void(const std::string& word, size_t count)> WordVisitor;
+
+/**
+	@class WordsIndex
+	@brief Compact trie over a finished vocabulary.
+
+	Read-only trie built once from the sorted word list of WordsStorage. All
+	nodes live in a single array and the children of each node are stored
+	contiguously and sorted, so the index takes a few bytes per character and
+	its queries run in time proportional to the visited part of the trie (i.e.,
+	to the output) instead of to the vocabulary size. Exact lookups are not
+	answered here (the hash table of WordsStorage is faster for them).
+
+	The trie has no pointers (children are referenced by index), so it can
+	also be queried in place from memory owned by someone else, e.g., a
+	shared-memory segment (see attach()).
+*/
+class WordsIndex
+{
+public:
+	/// Trie node. Its children are nodes [firstChild, firstChild + numChildren).
+	struct Node
+	{
+		uint32_t firstChild;
+		uint32_t numChildren;
+		uint64_t count; /// Occurrences of the word ending here (0 if none)
+	};
+
+	WordsIndex();
+
+	WordsIndex(const WordsIndex&) = delete;
+	WordsIndex& operator=(const WordsIndex&) = delete;
+
+	/// Rebuild the index from words sorted in byte order (without repetitions).
+	void build(const std::vector<const WordEntry*>& sorted);
+
+	/// Remove all words from the index.
+	void clear();
+
+	/**
+		@brief Use a trie stored elsewhere, without copying it.
+
+		'nodes' and 'labels' are arrays of 'numNodes' elements laid out like the
+		ones returned by nodes() and labels(). They must stay valid until the
+		index is rebuilt, cleared or destroyed.
+	*/
+	void attach(const Node* nodes, const char* labels, size_t numNodes);
+
+	/// Get the trie nodes (the root is the first one).
+	const Node* nodes() const { return m_nodeData; }
+
+	/// Get the character leading to each node.
+	const char* labels() const { return m_labelData; }
+
+	/// Get the number of trie nodes.
+	size_t numNodes() const { return m_numNodes; }
+
+	/**
+		@brief Get all words starting with a prefix.
+
+		Words are returned in the same order used by WordsStorage (byte order:
+		first, uppercase letters; second, lowercase letters). An empty prefix
+		returns the whole vocabulary.
+	*/
+	WordCountList findPrefix(const std::string& prefix) const;
+
+	/// Like findPrefix(), but stream the words to 'visit' instead of storing them.
+	void forEachPrefix(const std::string& prefix, const WordVisitor& visit) const;
+
+	/**
+		@brief Get all words within a given edit distance of a word.
+
+		Levenshtein distance (insertions, deletions and substitutions) is used.
+		Subtrees are pruned as soon as they cannot be within 'maxDistance', so
+		only a small part of the trie is visited for small distances. Only the
+		band of 2 * maxDistance + 1 distances that can be within 'maxDistance'
+		is computed for each character, so time and memory grow with the word
+		length times 'maxDistance'. Results are sorted like in findPrefix().
+	*/
+	WordCountList findSimilar(const std::string& word, size_t maxDistance = 1) const;
+
+private:
+	std::vector<Node> m_nodes; /// Nodes built by this index. The root is m_nodes[0].
+	std::vector<char> m_labels; /// Character leading to each node
+	const Node* m_nodeData; /// Nodes in use ('m_nodes' or attached ones)
+	const char* m_labelData; /// Labels in use ('m_labels' or attached ones)
+	size_t m_numNodes; /// Number of nodes in use
+
+	/// Query the nodes built by this index.
+	void useOwnNodes();
+
+	/// Get the child of a node reached with a character (0 if none).
+	uint32_t findChild(uint32_t node, char c) const;
+
+	/// Pass every word in the subtree of 'node' to 'visit'.
+	void collect(uint32_t node, std::string& word, const WordVisitor& visit) const;
+};
+
+#endif
@@ -24,11 +24,76 @@ int main2() {
   return 0;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  // Let std::cin buffer stdin itself, so that the pipeline stages only wait
+  // for input when its buffer is empty.
+  std::ios::sync_with_stdio(false);
+
   try {
     WordsStorage wordsSet;
-    wordsSet.readInputWords();
+
+    // words --budget <bytes> <other arguments>...
+    if (args.size() >= 2 && args[0] == "--budget") {
+      wordsSet.setMemoryBudget(std::stoull(args[1]));
+      args.erase(args.begin(), args.begin() + 2);
+    }
+
+    // words --merge <output> <count files>...
+    if (args.size() >= 2 && args[0] == "--merge") {
+      WordsStorage::mergeCountFiles({args.begin() + 2, args.end()}, args[1]);
+      return 0;
+    }
+
+    // words --export <output> [<input files or directories>...]
+    if (args.size() >= 2 && args[0] == "--export") {
+      if (args.size() > 2)
+        wordsSet.readInputFiles({args.begin() + 2, args.end()});
+      else
+        wordsSet.readInputWords();
+      wordsSet.exportCounts(args[1]);
+      return 0;
+    }
+
+    // words --publish <name> [<input files or directories>...]
+    if (args.size() >= 2 && args[0] == "--publish") {
+      if (args.size() > 2)
+        wordsSet.readInputFiles({args.begin() + 2, args.end()});
+      else
+        wordsSet.readInputWords();
+      wordsSet.publishShared(args[1]);
+      return 0;
+    }
+
+    // words --unpublish <name>
+    if (args.size() == 2 && args[0] == "--unpublish") {
+      SharedWords::remove(args[1]);
+      return 0;
+    }
+
+    // words --attach <name>
+    if (args.size() == 2 && args[0] == "--attach") {
+      wordsSet.attachShared(args[1]);
+      wordsSet.lookupWords();
+      wordsSet.printWordsFound();
+      return 0;
+    }
+
+    // words --counts <count files>...
+    if (args.size() && args[0] == "--counts")
+      wordsSet.readCountFiles({args.begin() + 1, args.end()});
+    else if (args.size()) // Input files or directories
+      wordsSet.readInputFiles(args);
+    else
+      wordsSet.readInputWords();
     wordsSet.printWordsList();
+    if (wordsSet.isSpilled()) {
+      std::cout << "\nLookups are not available: the word list exceeds the "
+                   "memory budget."
+                << std::endl;
+      return 0;
+    }
     wordsSet.lookupWords();
     wordsSet.printWordsFound();
   } catch (std::exception &e) {
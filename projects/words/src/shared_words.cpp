@@ -0,0 +1,424 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include "shared_words.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SHARED_WORDS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char segmentMagic[8] = {'W', 'O', 'R', 'D', 'S', 'H', 'M', '\0'};
+const uint32_t segmentFormat = 1;
+
+/// Maximum attempts at opening the current version while writers swap it.
+const int attachAttempts = 8;
+
+/// FNV-1a hash. Unlike std::hash, it is the same in every process.
+uint64_t hashWord(const char *word, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<unsigned char>(word[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t align8(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+/// Check that 'count' elements of 'elemSize' bytes at 'offset' fit in 'size'.
+bool fits(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t size) {
+  return offset <= size && count <= (size - offset) / elemSize;
+}
+
+/// Get the POSIX name ("/name") of the control segment.
+std::string controlName(const std::string &name) {
+  std::string result = name.size() && name[0] == '/' ? name : "/" + name;
+  if (result.size() < 2 || result.find('/', 1) != std::string::npos)
+    throw std::invalid_argument("Invalid shared words name: \"" + name + "\"");
+  return result;
+}
+
+/// Get the name of the segment of a version.
+std::string versionName(const std::string &control, uint64_t version) {
+  return control + "." + std::to_string(version);
+}
+
+} // namespace
+
+/// Start of a version segment. All the offsets are from its first byte.
+struct SharedWords::Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t reserved;
+  uint64_t version;
+  uint64_t size;         /// Size of the segment
+  uint64_t numWords;     /// Entries at 'entriesOffset'
+  uint64_t numBuckets;   /// uint32_t buckets at 'bucketsOffset' (power of 2)
+  uint64_t numNodes;     /// Nodes at 'nodesOffset', labels at 'labelsOffset'
+  uint64_t stringsSize;  /// Characters of the words at 'stringsOffset'
+  uint64_t entriesOffset;
+  uint64_t bucketsOffset;
+  uint64_t nodesOffset;
+  uint64_t labelsOffset;
+  uint64_t stringsOffset;
+};
+
+/// Stored word. Buckets hold entry indices plus one (0 is an empty bucket).
+struct SharedWords::Entry {
+  uint64_t hash;
+  uint64_t count;
+  uint64_t wordOffset; /// From 'stringsOffset'
+  uint64_t wordLength;
+};
+
+/// Control segment. 'version' is 0 until something is published.
+struct SharedWords::Control {
+  char magic[8];
+  std::atomic<uint64_t> version;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared version numbers need lock-free atomics");
+
+#if defined(SHARED_WORDS_POSIX)
+
+namespace {
+
+[[noreturn]] void throwErrno(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+/// Map a whole segment and close its descriptor.
+void *mapSegment(int fd, size_t size, int protection,
+                 const std::string &name) {
+  void *address = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+  int error = errno;
+  close(fd);
+  if (address == MAP_FAILED) {
+    errno = error;
+    throwErrno("mmap " + name);
+  }
+  return address;
+}
+
+/// Get the size of an open segment.
+size_t segmentSize(int fd, const std::string &name) {
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    throwErrno("fstat " + name);
+  }
+  return static_cast<size_t>(info.st_size);
+}
+
+} // namespace
+
+SharedWords::SharedWords(const std::string &name)
+    : m_name(controlName(name)), m_control(nullptr), m_data(nullptr),
+      m_dataSize(0) {
+  int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    if (errno == ENOENT)
+      throw std::runtime_error("No words published as " + m_name);
+    throwErrno("shm_open " + m_name);
+  }
+  if (segmentSize(fd, m_name) < sizeof(Control)) {
+    close(fd);
+    throw std::runtime_error("No words published as " + m_name);
+  }
+  m_control = static_cast<const Control *>(
+      mapSegment(fd, sizeof(Control), PROT_READ, m_name));
+
+  try {
+    attachCurrent();
+  } catch (const std::exception &e) {
+    munmap(const_cast<Control *>(m_control), sizeof(Control));
+    throw;
+  }
+}
+
+SharedWords::~SharedWords() {
+  detach();
+  munmap(const_cast<Control *>(m_control), sizeof(Control));
+}
+
+uint64_t SharedWords::publish(const std::string &name,
+                              const WordsIndex &index) {
+  std::string control = controlName(name);
+
+  // Compute the layout: header, entries, trie nodes, buckets, labels, words.
+  uint64_t numWords = 0, stringsSize = 0;
+  index.forEachPrefix("", [&](const std::string &word, size_t) {
+    ++numWords;
+    stringsSize += word.size();
+  });
+
+  Header layout = {};
+  std::memcpy(layout.magic, segmentMagic, sizeof(segmentMagic));
+  layout.format = segmentFormat;
+  layout.numWords = numWords;
+  layout.numBuckets = 1;
+  while (layout.numBuckets < 2 * numWords)
+    layout.numBuckets *= 2;
+  layout.numNodes = index.numNodes();
+  layout.stringsSize = stringsSize;
+  layout.entriesOffset = align8(sizeof(Header));
+  layout.nodesOffset = layout.entriesOffset + numWords * sizeof(Entry);
+  layout.bucketsOffset =
+      layout.nodesOffset + layout.numNodes * sizeof(WordsIndex::Node);
+  layout.labelsOffset = layout.bucketsOffset + layout.numBuckets * 4;
+  layout.stringsOffset = layout.labelsOffset + layout.numNodes;
+  layout.size = layout.stringsOffset + stringsSize;
+
+  // Open (or create) the control segment.
+  int fd = shm_open(control.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    throwErrno("shm_open " + control);
+  if (segmentSize(fd, control) < sizeof(Control) &&
+      ftruncate(fd, sizeof(Control)) < 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    throwErrno("ftruncate " + control);
+  }
+  Control *ctl = static_cast<Control *>(
+      mapSegment(fd, sizeof(Control), PROT_READ | PROT_WRITE, control));
+
+  uint64_t current = ctl->version.load(std::memory_order_acquire);
+  if (!current)
+    std::memcpy(ctl->magic, segmentMagic, sizeof(segmentMagic));
+  else if (std::memcmp(ctl->magic, segmentMagic, sizeof(segmentMagic))) {
+    munmap(ctl, sizeof(Control));
+    throw std::runtime_error(control + " is not a shared words segment");
+  }
+  layout.version = current + 1;
+  std::string segment = versionName(control, layout.version);
+
+  try {
+    // Write the new version in its own segment.
+    shm_unlink(segment.c_str()); // Left by a writer that didn't finish
+    fd = shm_open(segment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+      throwErrno("shm_open " + segment);
+    if (ftruncate(fd, static_cast<off_t>(layout.size)) < 0) {
+      int error = errno;
+      close(fd);
+      shm_unlink(segment.c_str());
+      errno = error;
+      throwErrno("ftruncate " + segment);
+    }
+
+    char *data;
+    try {
+      data = static_cast<char *>(mapSegment(
+          fd, layout.size, PROT_READ | PROT_WRITE, segment));
+    } catch (const std::exception &e) {
+      shm_unlink(segment.c_str());
+      throw;
+    }
+
+    std::memcpy(data, &layout, sizeof(Header));
+    Entry *entries = reinterpret_cast<Entry *>(data + layout.entriesOffset);
+    uint32_t *buckets =
+        reinterpret_cast<uint32_t *>(data + layout.bucketsOffset);
+    char *strings = data + layout.stringsOffset;
+    const uint64_t mask = layout.numBuckets - 1;
+
+    uint64_t i = 0, stringPos = 0;
+    index.forEachPrefix("", [&](const std::string &word, size_t count) {
+      entries[i] = {hashWord(word.data(), word.size()), count, stringPos,
+                    word.size()};
+      std::memcpy(strings + stringPos, word.data(), word.size());
+      stringPos += word.size();
+
+      uint64_t bucket = entries[i].hash & mask;
+      while (buckets[bucket])
+        bucket = (bucket + 1) & mask;
+      buckets[bucket] = static_cast<uint32_t>(++i);
+    });
+
+    std::memcpy(data + layout.nodesOffset, index.nodes(),
+                layout.numNodes * sizeof(WordsIndex::Node));
+    std::memcpy(data + layout.labelsOffset, index.labels(), layout.numNodes);
+    munmap(data, layout.size);
+
+    // Swap versions. Readers attached to the previous one keep their mapping.
+    if (!ctl->version.compare_exchange_strong(current, layout.version,
+                                              std::memory_order_acq_rel)) {
+      shm_unlink(segment.c_str());
+      throw std::runtime_error("Another process published " + control +
+                               " at the same time");
+    }
+    if (current)
+      shm_unlink(versionName(control, current).c_str());
+  } catch (const std::exception &e) {
+    munmap(ctl, sizeof(Control));
+    throw;
+  }
+
+  munmap(ctl, sizeof(Control));
+  return layout.version;
+}
+
+void SharedWords::remove(const std::string &name) {
+  std::string control = controlName(name);
+
+  int fd = shm_open(control.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return; // Nothing published
+  if (segmentSize(fd, control) >= sizeof(Control)) {
+    Control *ctl = static_cast<Control *>(
+        mapSegment(fd, sizeof(Control), PROT_READ, control));
+    uint64_t version = ctl->version.load(std::memory_order_acquire);
+    munmap(ctl, sizeof(Control));
+    if (version)
+      shm_unlink(versionName(control, version).c_str());
+  } else
+    close(fd);
+
+  shm_unlink(control.c_str());
+}
+
+bool SharedWords::refresh() {
+  if (m_control->version.load(std::memory_order_acquire) == version())
+    return false;
+
+  attachCurrent();
+  return true;
+}
+
+void SharedWords::attachCurrent() {
+  for (int attempt = 0; attempt < attachAttempts; attempt++) {
+    uint64_t version = m_control->version.load(std::memory_order_acquire);
+    if (!version)
+      throw std::runtime_error("No words published as " + m_name);
+
+    // The writer may unlink this version right after swapping it: try again.
+    std::string segment = versionName(m_name, version);
+    int fd = shm_open(segment.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      if (errno == ENOENT)
+        continue;
+      throwErrno("shm_open " + segment);
+    }
+
+    size_t size = segmentSize(fd, segment);
+    if (size < sizeof(Header)) {
+      close(fd);
+      throw std::runtime_error("Corrupt shared words segment " + segment);
+    }
+    const char *data =
+        static_cast<const char *>(mapSegment(fd, size, PROT_READ, segment));
+
+    // Check the header, so that no query reads outside the segment.
+    const Header &h = *reinterpret_cast<const Header *>(data);
+    if (std::memcmp(h.magic, segmentMagic, sizeof(segmentMagic)) ||
+        h.format != segmentFormat || h.version != version || h.size != size ||
+        !h.numNodes || h.numNodes > UINT32_MAX ||
+        h.numBuckets <= h.numWords || (h.numBuckets & (h.numBuckets - 1)) ||
+        h.entriesOffset % 8 || h.nodesOffset % 8 || h.bucketsOffset % 4 ||
+        !fits(h.entriesOffset, h.numWords, sizeof(Entry), size) ||
+        !fits(h.nodesOffset, h.numNodes, sizeof(WordsIndex::Node), size) ||
+        !fits(h.bucketsOffset, h.numBuckets, 4, size) ||
+        !fits(h.labelsOffset, h.numNodes, 1, size) ||
+        !fits(h.stringsOffset, h.stringsSize, 1, size)) {
+      munmap(const_cast<char *>(data), size);
+      throw std::runtime_error("Corrupt shared words segment " + segment);
+    }
+
+    detach();
+    m_data = data;
+    m_dataSize = size;
+    m_index.attach(
+        reinterpret_cast<const WordsIndex::Node *>(data + h.nodesOffset),
+        data + h.labelsOffset, h.numNodes);
+    return;
+  }
+
+  throw std::runtime_error("Could not attach to " + m_name +
+                           ": it keeps being replaced");
+}
+
+void SharedWords::detach() {
+  if (!m_data)
+    return;
+
+  m_index.clear();
+  munmap(const_cast<char *>(m_data), m_dataSize);
+  m_data = nullptr;
+  m_dataSize = 0;
+}
+
+#else // Shared memory not available
+
+SharedWords::SharedWords(const std::string &name)
+    : m_name(controlName(name)), m_control(nullptr), m_data(nullptr),
+      m_dataSize(0) {
+  throw std::runtime_error("Shared memory is not supported on this platform");
+}
+
+SharedWords::~SharedWords() {}
+
+uint64_t SharedWords::publish(const std::string &name, const WordsIndex &) {
+  throw std::runtime_error("Shared memory is not supported on this platform");
+}
+
+void SharedWords::remove(const std::string &name) {
+  throw std::runtime_error("Shared memory is not supported on this platform");
+}
+
+bool SharedWords::refresh() { return false; }
+
+void SharedWords::attachCurrent() {}
+
+void SharedWords::detach() {}
+
+#endif
+
+uint64_t SharedWords::version() const { return header().version; }
+
+size_t SharedWords::size() const { return header().numWords; }
+
+size_t SharedWords::count(const std::string &word) const {
+  const Header &h = header();
+  const Entry *entries =
+      reinterpret_cast<const Entry *>(m_data + h.entriesOffset);
+  const uint32_t *buckets =
+      reinterpret_cast<const uint32_t *>(m_data + h.bucketsOffset);
+  const char *strings = m_data + h.stringsOffset;
+
+  // Linear probing until an empty bucket (the table is at most half full).
+  uint64_t hash = hashWord(word.data(), word.size());
+  uint64_t mask = h.numBuckets - 1;
+  for (uint64_t i = 0, bucket = hash & mask; i < h.numBuckets;
+       i++, bucket = (bucket + 1) & mask) {
+    uint32_t entry = buckets[bucket];
+    if (!entry)
+      return 0;
+    if (entry > h.numWords)
+      break; // Corrupt bucket
+
+    const Entry &e = entries[entry - 1];
+    if (e.hash == hash && e.wordLength == word.size() &&
+        fits(e.wordOffset, e.wordLength, 1, h.stringsSize) &&
+        !std::memcmp(strings + e.wordOffset, word.data(), word.size()))
+      return e.count;
+  }
+
+  return 0;
+}
+
+const SharedWords::Header &SharedWords::header() const {
+  return *reinterpret_cast<const Header *>(m_data);
+}
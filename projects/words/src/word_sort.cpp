@@ -0,0 +1,308 @@
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+#include "word_sort.hpp"
+
+namespace {
+
+const char runMagic[4] = {'W', 'R', 'U', 'N'};
+const uint32_t runVersion = 1;
+const size_t runHeaderSize = 8;
+const size_t blockSize = 1 << 16;
+
+void putUint(std::string &out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++)
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+uint64_t getUint(const char *in, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++)
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+  return value;
+}
+
+bool lessWord(const std::pair<std::string, size_t> &a,
+              const std::pair<std::string, size_t> &b) {
+  return a.first < b.first;
+}
+
+} // namespace
+
+void sortWordCounts(WordCountList &words, unsigned numChunks) {
+  parallelSort(words.begin(), words.end(), lessWord, numChunks);
+}
+
+WordRunWriter::WordRunWriter(const std::string &path)
+    : m_buffer(blockSize), m_path(path), m_empty(true) {
+  m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+  m_file.open(path, std::ios_base::binary | std::ios_base::trunc);
+  if (!m_file.is_open())
+    throw std::runtime_error("Cannot create run file " + path);
+
+  std::string header(runMagic, sizeof(runMagic));
+  putUint(header, runVersion, 4);
+  m_file.write(header.data(), header.size());
+}
+
+void WordRunWriter::write(const std::string &word, size_t count) {
+  if (!m_empty && !(m_lastWord < word))
+    throw std::logic_error("Words must be written to " + m_path +
+                           " in increasing order.");
+  if (word.size() > UINT32_MAX)
+    throw std::length_error("Word too long for run file " + m_path);
+  if (!count)
+    throw std::logic_error("Words written to " + m_path +
+                           " must have occurrences.");
+
+  std::string record;
+  record.reserve(word.size() + 12);
+  putUint(record, word.size(), 4);
+  record += word;
+  putUint(record, count, 8);
+  m_file.write(record.data(), record.size());
+
+  m_lastWord = word;
+  m_empty = false;
+}
+
+void WordRunWriter::close() {
+  m_file.close();
+  if (m_file.fail())
+    throw std::runtime_error("Failure when writing run file " + m_path);
+}
+
+WordRunReader::WordRunReader(const std::string &path)
+    : m_buffer(blockSize), m_path(path), m_fileSize(0), m_offset(0) {
+  m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+  m_file.open(path, std::ios_base::binary);
+  if (!m_file.is_open())
+    throw std::runtime_error("Cannot open run file " + path);
+
+  std::error_code error;
+  m_fileSize = std::filesystem::file_size(path, error);
+  if (error)
+    throw std::runtime_error("Cannot get the size of run file " + path);
+
+  char header[runHeaderSize];
+  if (m_fileSize < runHeaderSize || !m_file.read(header, runHeaderSize) ||
+      std::memcmp(header, runMagic, sizeof(runMagic)))
+    corrupt("not a run file");
+  if (getUint(header + 4, 4) != runVersion)
+    corrupt("unsupported version " + std::to_string(getUint(header + 4, 4)));
+
+  m_offset = runHeaderSize;
+}
+
+bool WordRunReader::next(std::string &word, size_t &count) {
+  if (m_offset == m_fileSize)
+    return false;
+
+  char field[8];
+  if (m_fileSize - m_offset < 12 || !m_file.read(field, 4))
+    corrupt("truncated record");
+
+  uint64_t length = getUint(field, 4);
+  if (length > m_fileSize - m_offset - 12)
+    corrupt("word length " + std::to_string(length) + " exceeds file size");
+
+  word.resize(length);
+  if (!m_file.read(&word[0], length) || !m_file.read(field, 8))
+    corrupt("truncated record");
+  count = getUint(field, 8);
+
+  if (m_offset > runHeaderSize && !(m_lastWord < word))
+    corrupt("words out of order");
+  if (!count)
+    corrupt("word without occurrences");
+
+  m_lastWord = word;
+  m_offset += 12 + length;
+  return true;
+}
+
+void WordRunReader::corrupt(const std::string &reason) const {
+  throw std::runtime_error("Corrupt run file " + m_path + " at offset " +
+                           std::to_string(m_offset) + ": " + reason);
+}
+
+namespace {
+
+/// Merge all the runs at once (one open reader per run).
+void mergeRunsOnce(const std::vector<std::string> &runPaths,
+                   const WordVisitor &visit) {
+  struct Head {
+    std::string word;
+    size_t count;
+    size_t run;
+  };
+  auto greater = [](const Head &a, const Head &b) { return a.word > b.word; };
+  std::priority_queue<Head, std::vector<Head>, decltype(greater)> heads(greater);
+
+  std::vector<WordRunReader> readers;
+  readers.reserve(runPaths.size());
+  for (size_t i = 0; i < runPaths.size(); i++) {
+    readers.emplace_back(runPaths[i]);
+    Head head{"", 0, i};
+    if (readers[i].next(head.word, head.count))
+      heads.push(std::move(head));
+  }
+
+  std::string word;
+  size_t count = 0;
+  bool pending = false;
+
+  while (!heads.empty()) {
+    Head head = heads.top();
+    heads.pop();
+
+    if (pending && head.word == word)
+      count += head.count;
+    else {
+      if (pending)
+        visit(word, count);
+      word = head.word;
+      count = head.count;
+      pending = true;
+    }
+
+    if (readers[head.run].next(head.word, head.count))
+      heads.push(std::move(head));
+  }
+
+  if (pending)
+    visit(word, count);
+}
+
+/// Removes temporary run files when destroyed (also on exceptions).
+struct TempRuns {
+  std::vector<std::string> paths;
+
+  ~TempRuns() {
+    std::error_code error;
+    for (const auto &path : paths)
+      std::filesystem::remove(path, error);
+  }
+};
+
+} // namespace
+
+std::string newRunPath(const std::string &tempDir) {
+  static std::atomic<unsigned> runCounter(0);
+  static const unsigned long long processTag = std::random_device()();
+
+  std::filesystem::path dir = tempDir.empty()
+                                 ? std::filesystem::temp_directory_path()
+                                 : std::filesystem::path(tempDir);
+  return (dir / ("words_run_" + std::to_string(processTag) + "_" +
+                 std::to_string(runCounter++) + ".bin"))
+      .string();
+}
+
+void mergeWordRuns(const std::vector<std::string> &runPaths,
+                   const WordVisitor &visit, size_t maxFanIn,
+                   const std::string &tempDir) {
+  maxFanIn = std::max<size_t>(maxFanIn, 2);
+  std::vector<std::string> level(runPaths);
+  TempRuns intermediate;
+
+  // Each pass merges groups of runs into fewer, longer runs.
+  while (level.size() > maxFanIn) {
+    std::vector<std::string> next;
+    for (size_t first = 0; first < level.size(); first += maxFanIn) {
+      size_t last = std::min(level.size(), first + maxFanIn);
+      if (last - first == 1) { // Nothing to merge it with
+        next.push_back(level[first]);
+        continue;
+      }
+
+      intermediate.paths.push_back(newRunPath(tempDir));
+      WordRunWriter writer(intermediate.paths.back());
+      mergeRunsOnce({level.begin() + first, level.begin() + last},
+                    [&writer](const std::string &word, size_t count) {
+                      writer.write(word, count);
+                    });
+      writer.close();
+      next.push_back(intermediate.paths.back());
+    }
+    level.swap(next);
+  }
+
+  mergeRunsOnce(level, visit);
+}
+
+ExternalWordSorter::ExternalWordSorter(size_t memoryBudget, std::string tempDir)
+    : m_bufferBytes(0), m_memoryBudget(memoryBudget), m_tempDir(tempDir) {
+  if (m_tempDir.empty())
+    m_tempDir = std::filesystem::temp_directory_path().string();
+}
+
+ExternalWordSorter::~ExternalWordSorter() {
+  std::error_code error;
+  for (const auto &path : m_runs)
+    std::filesystem::remove(path, error);
+}
+
+void ExternalWordSorter::add(std::string word, size_t count) {
+  m_bufferBytes += sizeof(m_buffer[0]) + word.capacity();
+  m_buffer.emplace_back(std::move(word), count);
+
+  if (m_bufferBytes > m_memoryBudget)
+    spill();
+}
+
+void ExternalWordSorter::merge(const WordVisitor &visit) {
+  sortBuffer();
+
+  if (m_runs.empty()) {
+    for (const auto &p : m_buffer)
+      visit(p.first, p.second);
+    return;
+  }
+
+  if (m_buffer.size())
+    spill();
+  mergeWordRuns(m_runs, visit, defaultMaxFanIn, m_tempDir);
+}
+
+size_t ExternalWordSorter::numRuns() const { return m_runs.size(); }
+
+void ExternalWordSorter::flush() {
+  if (m_buffer.size())
+    spill();
+}
+
+void ExternalWordSorter::sortBuffer() {
+  sortWordCounts(m_buffer);
+
+  // Combine repeated words.
+  size_t last = 0;
+  for (size_t i = 1; i < m_buffer.size(); i++) {
+    if (m_buffer[i].first == m_buffer[last].first)
+      m_buffer[last].second += m_buffer[i].second;
+    else if (++last != i)
+      m_buffer[last] = std::move(m_buffer[i]);
+  }
+  if (m_buffer.size())
+    m_buffer.resize(last + 1);
+}
+
+void ExternalWordSorter::spill() {
+  sortBuffer();
+
+  std::string path = newRunPath(m_tempDir);
+  m_runs.push_back(path);
+
+  WordRunWriter writer(path);
+  for (const auto &p : m_buffer)
+    writer.write(p.first, p.second);
+  writer.close();
+
+  m_buffer.clear();
+  m_buffer.shrink_to_fit();
+  m_bufferBytes = 0;
+}
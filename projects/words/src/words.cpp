@@ -1,110 +1,425 @@
 #include <algorithm>
 #include <cctype>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <fstream>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
 
+#include "thread_pool.hpp"
+#include "word_sort.hpp"
 #include "words.hpp"
 
-WordsStorage::WordsStorage() : m_totalFound(0) {}
+namespace {
+
+/// Write the words that 'produce' passes to its visitor to a count file.
+/// They go to a temporary file next to 'path' that replaces it only once
+/// complete, so a failure leaves 'path' as it was and 'produce' may read it.
+void writeCountFile(const std::string &path,
+                    const std::function<void(const WordVisitor &)> &produce) {
+  std::filesystem::path dir = std::filesystem::path(path).parent_path();
+  std::string tempPath = newRunPath(dir.empty() ? "." : dir.string());
+
+  try {
+    WordRunWriter writer(tempPath);
+    produce([&writer](const std::string &word, size_t count) {
+      writer.write(word, count);
+    });
+    writer.close();
+    std::filesystem::rename(tempPath, path);
+  } catch (...) {
+    std::error_code error;
+    std::filesystem::remove(tempPath, error);
+    throw;
+  }
+}
+
+} // namespace
+
+WordsStorage::WordsStorage()
+    : m_totalFound(0), m_memoryBudget(0), m_wordsBytes(0) {}
 
 WordsStorage::~WordsStorage() {}
 
+void WordsStorage::setMemoryBudget(size_t bytes) { m_memoryBudget = bytes; }
+
+bool WordsStorage::isSpilled() const { return m_spilled != nullptr; }
+
 void WordsStorage::readInputWords() {
+  Scheduler scheduler;
+  Channel<std::string> words(scheduler, pipelineCapacity);
+
+  scheduler.spawn(readWordsStage(scheduler, words));
+  scheduler.spawn(storeWordsStage(words));
+
+  try {
+    scheduler.run();
+  } catch (const std::exception &e) {
+    rebuildIndex();
+    throw;
+  }
+
+  rebuildIndex();
+}
+
+Task WordsStorage::readWordsStage(Scheduler &scheduler,
+                                  Channel<std::string> &words) {
   std::string linebuf;
-  std::thread worker(std::thread(&WordsStorage::workerThread, this));
 
   try {
-    do {
-      // Get input line. Ignore EOF.
+    for (;;) {
+      // Get input line (waiting for it without blocking other stages).
+      // Ignore EOF.
+      co_await scheduler.stdinReadable();
       if (!std::getline(std::cin, linebuf))
         handleCinError();
 
-      // Get first word of the line.
-      std::istringstream iss(linebuf);
-      iss >> linebuf;
-
-      // Discard empty word or words containing a non-letter character.
-      if (linebuf == "" || isAllAlpha(linebuf) == false)
+      // Get first word of the line. Discard empty word or words containing
+      // a non-letter character.
+      if (!extractWord(linebuf, linebuf))
         continue;
 
-      // Wait for idle worker and pass word to worker safely.
-      std::lock_guard<std::mutex> lock(m_mtxWord);
-      m_words.push(linebuf);
-      m_condVar.notify_one(); // Wake up the worker thread
+      if (linebuf == "end")
+        break;
 
-    } while (linebuf != "end");
+      // Pass word to the storage stage (waits while the channel is full).
+      if (!co_await words.push(linebuf))
+        break; // The storage stage failed
+    }
+  } catch (const std::exception &e) {
+    words.close(); // Let the storage stage finish
+    throw;
+  }
+
+  words.close();
+}
 
-    // Wait for worker to terminate
-    if (worker.joinable())
-      worker.join();
+Task WordsStorage::storeWordsStage(Channel<std::string> &words) {
+  try {
+    while (std::optional<std::string> word = co_await words.pop())
+      storeWord(*word, 1);
   } catch (const std::exception &e) {
-    finishWorker(worker);
+    words.close(); // Stop the read stage
     throw;
   }
 }
 
-void WordsStorage::workerThread() {
-  // Keep m_word locked except when worker sleeps.
-  std::unique_lock<std::mutex> lock(m_mtxWord);
+void WordsStorage::readInputFiles(const std::vector<std::string> &paths) {
+  // Expand directories into their files.
+  std::vector<std::string> files;
+  for (const auto &path : paths) {
+    if (!std::filesystem::is_directory(path)) {
+      files.push_back(path);
+      continue;
+    }
 
-  std::string newWord;
-  std::map<std::string, size_t>::iterator iter;
+    std::vector<std::string> dirFiles;
+    for (const auto &entry : std::filesystem::directory_iterator(path))
+      if (entry.is_regular_file())
+        dirFiles.push_back(entry.path().string());
+    std::sort(dirFiles.begin(), dirFiles.end());
+    files.insert(files.end(), dirFiles.begin(), dirFiles.end());
+  }
 
-  for (;;) {
-    // Wait for new words
-    m_condVar.wait(lock, [this] { return m_words.size(); });
+  // Files are counted in chunks, each one into its own hash table (no
+  // locking per word), and the tables are merged into storage at the end.
+  // If any file fails, parallelFor() throws before anything is stored
+  // (which chunks finished is not deterministic).
+  size_t grain = defaultGrain(files.size());
+  std::vector<std::unordered_map<std::string, size_t>> partial(
+      files.empty() ? 0 : (files.size() - 1) / grain + 1);
 
-    // Get new word.
-    newWord = m_words.front();
-    m_words.pop();
+  parallelFor(
+      0, files.size(),
+      [&](size_t first, size_t last) {
+        auto &counts = partial[first / grain];
+        for (size_t i = first; i < last; i++)
+          countFileWords(files[i], counts);
+      },
+      grain);
 
-    // Exit loop condition.
-    if (newWord == "end")
-      break;
+  for (const auto &counts : partial)
+    for (const auto &p : counts)
+      storeWord(p.first, p.second);
 
-    // Save new word.
-    iter = m_wordsArray.find(newWord);
-    if (iter != m_wordsArray.end())
-      iter->second++;
+  rebuildIndex();
+}
+
+void WordsStorage::readCountFiles(const std::vector<std::string> &paths) {
+  // The files are merged into a temporary table first, so that a corrupt
+  // file leaves storage unchanged. With a memory budget, the table is a
+  // temporary run file instead of a list in memory.
+  if (m_memoryBudget) {
+    std::string mergedPath = newRunPath();
+    try {
+      mergeCountFiles(paths, mergedPath);
+      mergeWordRuns({mergedPath}, [this](const std::string &word,
+                                         size_t count) {
+        storeWord(word, count);
+      });
+    } catch (...) {
+      std::filesystem::remove(mergedPath);
+      throw;
+    }
+    std::filesystem::remove(mergedPath);
+  } else {
+    WordCountList merged;
+    mergeWordRuns(paths, [&merged](const std::string &word, size_t count) {
+      merged.emplace_back(word, count);
+    });
+    for (const auto &p : merged)
+      storeWord(p.first, p.second);
+  }
+
+  rebuildIndex();
+}
+
+void WordsStorage::exportCounts(const std::string &path) const {
+  writeCountFile(path, [this](const WordVisitor &write) {
+    if (m_spilled)
+      m_spilled->merge(write);
     else
-      m_wordsArray[newWord] = 1U;
+      index().forEachPrefix("", write);
+  });
+}
+
+void WordsStorage::publishShared(const std::string &name) const {
+  SharedWords::publish(name, index());
+}
+
+void WordsStorage::attachShared(const std::string &name) {
+  m_shared = std::make_unique<SharedWords>(name);
+}
+
+void WordsStorage::mergeCountFiles(const std::vector<std::string> &inputs,
+                                   const std::string &output) {
+  writeCountFile(output, [&inputs](const WordVisitor &write) {
+    mergeWordRuns(inputs, write);
+  });
+}
+
+void WordsStorage::countFileWords(
+    const std::string &path, std::unordered_map<std::string, size_t> &counts) {
+  std::vector<char> buffer(1 << 16);
+  std::ifstream file;
+  file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  file.open(path);
+  if (!file.is_open())
+    throw std::runtime_error("Input file " + path + " cannot be opened.");
+
+  std::string linebuf, word;
+  while (std::getline(file, linebuf)) {
+    if (!extractWord(linebuf, word))
+      continue;
+    if (word == "end")
+      break;
+    ++counts[word];
   }
+
+  if (file.bad())
+    throw std::runtime_error("Failure when reading from " + path + ".");
 }
 
 void WordsStorage::lookupWords() {
+  if (!m_shared)
+    checkInMemory();
+
+  Scheduler scheduler;
+  Channel<std::string> lines(scheduler, pipelineCapacity);
+  Channel<std::string> output(scheduler, pipelineCapacity);
+
+  scheduler.spawn(readLinesStage(scheduler, lines));
+  scheduler.spawn(lookupStage(lines, output));
+  scheduler.spawn(writeStage(output));
+  scheduler.run();
+}
+
+Task WordsStorage::readLinesStage(Scheduler &scheduler,
+                                  Channel<std::string> &lines) {
   std::string linebuf;
-  std::map<std::string, size_t>::iterator iter;
 
-  for (;;) {
-    std::cout << "\nEnter a word for lookup:" << std::flush;
-    if (!std::getline(std::cin, linebuf)) { // Get line & check for EOF/error
-      handleCinError();
-      return;
+  try {
+    for (;;) {
+      co_await scheduler.stdinReadable();
+      if (!std::getline(std::cin, linebuf)) { // Get line & check for EOF/error
+        handleCinError();
+        break;
+      }
+
+      if (!co_await lines.push(linebuf))
+        break; // The lookup stage failed
     }
+  } catch (const std::exception &e) {
+    lines.close();
+    throw;
+  }
+
+  lines.close();
+}
+
+Task WordsStorage::lookupStage(Channel<std::string> &lines,
+                               Channel<std::string> &output) {
+  const std::string prompt("\nEnter a word for lookup:");
+
+  try {
+    co_await output.push(prompt);
+    while (std::optional<std::string> line = co_await lines.pop())
+      co_await output.push(lookupLine(*line) + prompt);
+  } catch (const std::exception &e) {
+    lines.close();  // Stop the read stage
+    output.close(); // Let the write stage finish
+    throw;
+  }
+
+  output.close();
+}
+
+Task WordsStorage::writeStage(Channel<std::string> &output) {
+  while (std::optional<std::string> text = co_await output.pop()) {
+    std::cout << *text;
+    if (output.empty()) // Nothing else to write: show it before waiting
+      std::cout << std::flush;
+  }
+}
+
+std::string WordsStorage::lookupLine(const std::string &line) {
+  if (m_shared)
+    m_shared->refresh(); // Use the latest published vocabulary
 
-    // Search for the word
-    iter = m_wordsArray.find(linebuf);
-    if (iter != m_wordsArray.end()) // word found
-    {
-      std::cout << "Success: " << linebuf << " was present " << iter->second
-                << " times in the initial word list" << std::endl;
-      ++m_totalFound;
-    } else // word not found
-      std::cout << linebuf << " was NOT found in the initial word list"
-                << std::endl;
+  // List words starting with a prefix ("prefix*")
+  if (line.size() && line.back() == '*') {
+    std::string prefix(line, 0, line.size() - 1);
+    WordCountList matches = index().findPrefix(prefix);
+    std::string answer(std::to_string(matches.size()) +
+                       " words start with \"" + prefix + "\"\n");
+    for (const auto &p : matches)
+      answer += p.first + " " + std::to_string(p.second) + "\n";
+    return answer;
   }
+
+  // Search for the word
+  if (size_t count = countOf(line)) { // word found
+    ++m_totalFound;
+    return "Success: " + line + " was present " + std::to_string(count) +
+           " times in the initial word list\n";
+  }
+
+  // word not found
+  std::string answer(line + " was NOT found in the initial word list\n");
+  if (line.size() <= maxSuggestionLength)
+    answer += formatSuggestions(index().findSimilar(line));
+  return answer;
+}
+
+WordCountList WordsStorage::findPrefix(const std::string &prefix) const {
+  return index().findPrefix(prefix);
+}
+
+WordCountList WordsStorage::findSimilar(const std::string &word,
+                                        size_t maxDistance) const {
+  return index().findSimilar(word, maxDistance);
 }
 
 void WordsStorage::printWordsList() const {
-  std::cout << "\n=== Word list:" << std::endl;
-  for (const auto &p : m_wordsArray)
-    std::cout << p.first << " " << p.second << std::endl;
+  std::cout << "\n=== Word list:\n";
+  auto print = [](const std::string &word, size_t count) {
+    std::cout << word << " " << count << "\n";
+  };
+  if (m_spilled)
+    m_spilled->merge(print);
+  else
+    index().forEachPrefix("", print);
+  std::cout << std::flush;
 }
 
 void WordsStorage::printWordsFound() const {
   std::cout << "\n\n=== Total words found: " << m_totalFound << std::endl;
 }
 
+void WordsStorage::storeWord(const std::string &word, size_t count) {
+  auto inserted = m_wordsArray.try_emplace(word, 0);
+  inserted.first->second += count;
+  if (!inserted.second || !m_memoryBudget)
+    return;
+
+  // Hash node (entry, next pointer and hash) plus the characters, and what
+  // rebuildIndex() will add for the word while the table is still in memory:
+  // its pointer in the sorted vector and at most one trie node (and label)
+  // per character.
+  const std::string &stored = inserted.first->first;
+  m_wordsBytes += sizeof(WordEntry) + 2 * sizeof(void *) + stored.capacity() +
+                  sizeof(const WordEntry *) +
+                  stored.size() * (sizeof(WordsIndex::Node) + sizeof(char));
+  if (m_wordsBytes > m_memoryBudget)
+    spillWords();
+}
+
+void WordsStorage::spillWords() {
+  if (!m_spilled)
+    m_spilled = std::make_unique<ExternalWordSorter>(m_memoryBudget);
+
+  // Nodes are moved one by one, so the words are never held twice.
+  while (m_wordsArray.size()) {
+    auto node = m_wordsArray.extract(m_wordsArray.begin());
+    m_spilled->add(std::move(node.key()), node.mapped());
+  }
+  m_spilled->flush();
+  m_wordsBytes = 0;
+}
+
+void WordsStorage::checkInMemory() const {
+  if (m_spilled)
+    throw std::logic_error("The word list exceeds the memory budget: it is "
+                           "kept on disk and cannot be queried.");
+}
+
+void WordsStorage::rebuildIndex() {
+  if (m_spilled) { // The remaining words go to disk with the others
+    spillWords();
+    m_index.build({});
+    return;
+  }
+
+  std::vector<const WordEntry *> sorted;
+  sorted.reserve(m_wordsArray.size());
+  for (const auto &p : m_wordsArray)
+    sorted.push_back(&p);
+
+  parallelSort(sorted.begin(), sorted.end(),
+               [](const WordEntry *a, const WordEntry *b) {
+                 return a->first < b->first;
+               });
+  m_index.build(sorted);
+}
+
+const WordsIndex &WordsStorage::index() const {
+  if (m_shared)
+    return m_shared->index();
+  checkInMemory();
+  return m_index;
+}
+
+size_t WordsStorage::countOf(const std::string &word) const {
+  if (m_shared)
+    return m_shared->count(word);
+  checkInMemory();
+
+  auto iter = m_wordsArray.find(word);
+  return iter != m_wordsArray.end() ? iter->second : 0;
+}
+
+std::string WordsStorage::formatSuggestions(
+    const WordCountList &suggestions) const {
+  if (suggestions.empty())
+    return "";
+
+  std::string text("Did you mean: ");
+  for (size_t i = 0; i < suggestions.size(); i++)
+    text += (i ? ", " : "") + suggestions[i].first;
+  return text + "?\n";
+}
+
 void WordsStorage::handleCinError() const {
   if (std::cin.eof()) {
     clearerr(stdin);
@@ -114,17 +429,14 @@ void WordsStorage::handleCinError() const {
     throw std::runtime_error("Failure when reading from std::cin.");
 }
 
-void WordsStorage::finishWorker(std::thread &worker) {
-  // Pass word "end" to worker safely and wake it up.
-  {
-    std::lock_guard<std::mutex> lock(m_mtxWord); // Wait for idle worker
-    m_words.push("end");
-    m_condVar.notify_one(); // Wake up the worker thread
-  }
+bool WordsStorage::extractWord(const std::string &line, std::string &word) {
+  auto isSpace = [](unsigned char c) { return std::isspace(c); };
+  auto begin = std::find_if_not(line.begin(), line.end(), isSpace);
+  auto end = std::find_if(begin, line.end(), isSpace);
 
-  // Wait for worker to terminate
-  if (worker.joinable())
-    worker.join();
+  // 'word' may be 'line' itself, so 'line' is not used after assigning it.
+  word.assign(begin, end);
+  return word.size() && isAllAlpha(word);
 }
 
 bool WordsStorage::isAllAlpha(const std::string &str) {
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+#include "words_index.hpp"
+
+static_assert(sizeof(WordsIndex::Node) == 16,
+              "WordsIndex::Node must have a fixed layout");
+
+WordsIndex::WordsIndex() { clear(); }
+
+void WordsIndex::build(const std::vector<const WordEntry *> &sorted) {
+  clear();
+
+  // Pending node: every word in sorted[begin, end) shares its first 'depth'
+  // characters. Nodes are expanded breadth-first so that all the children of
+  // a node are appended together (contiguously).
+  struct Pending {
+    uint32_t node;
+    size_t begin, end, depth;
+  };
+  std::queue<Pending> pending;
+  pending.push({0, 0, sorted.size(), 0});
+
+  while (!pending.empty()) {
+    Pending item = pending.front();
+    pending.pop();
+
+    // A word ending here is the first one of the range (shortest word).
+    if (item.begin < item.end &&
+        sorted[item.begin]->first.size() == item.depth)
+      m_nodes[item.node].count = sorted[item.begin++]->second;
+
+    if (item.begin == item.end)
+      continue;
+
+    if (m_nodes.size() > UINT32_MAX - 256)
+      throw std::length_error("Vocabulary too large for the words index.");
+
+    // Group the remaining words by their next character.
+    m_nodes[item.node].firstChild = static_cast<uint32_t>(m_nodes.size());
+    size_t groupBegin = item.begin;
+    while (groupBegin < item.end) {
+      char c = sorted[groupBegin]->first[item.depth];
+      size_t groupEnd = groupBegin + 1;
+      while (groupEnd < item.end && sorted[groupEnd]->first[item.depth] == c)
+        ++groupEnd;
+
+      uint32_t child = static_cast<uint32_t>(m_nodes.size());
+      m_nodes.push_back({0, 0, 0});
+      m_labels.push_back(c);
+      m_nodes[item.node].numChildren++;
+      pending.push({child, groupBegin, groupEnd, item.depth + 1});
+
+      groupBegin = groupEnd;
+    }
+  }
+
+  m_nodes.shrink_to_fit();
+  m_labels.shrink_to_fit();
+  useOwnNodes();
+}
+
+void WordsIndex::clear() {
+  m_nodes.assign(1, {0, 0, 0});
+  m_labels.assign(1, '\0');
+  useOwnNodes();
+}
+
+void WordsIndex::attach(const Node *nodes, const char *labels,
+                        size_t numNodes) {
+  if (!numNodes)
+    throw std::invalid_argument("A words index needs a root node.");
+
+  m_nodes.clear();
+  m_nodes.shrink_to_fit();
+  m_labels.clear();
+  m_labels.shrink_to_fit();
+  m_nodeData = nodes;
+  m_labelData = labels;
+  m_numNodes = numNodes;
+}
+
+void WordsIndex::useOwnNodes() {
+  m_nodeData = m_nodes.data();
+  m_labelData = m_labels.data();
+  m_numNodes = m_nodes.size();
+}
+
+WordCountList WordsIndex::findPrefix(const std::string &prefix) const {
+  WordCountList result;
+  forEachPrefix(prefix, [&result](const std::string &word, size_t count) {
+    result.emplace_back(word, count);
+  });
+  return result;
+}
+
+void WordsIndex::forEachPrefix(const std::string &prefix,
+                               const WordVisitor &visit) const {
+  uint32_t node = 0;
+  for (char c : prefix)
+    if (!(node = findChild(node, c)))
+      return;
+
+  std::string word(prefix);
+  collect(node, word, visit);
+}
+
+WordCountList WordsIndex::findSimilar(const std::string &word,
+                                      size_t maxDistance) const {
+  // Banded Levenshtein DP. The row of a node at depth d only keeps the
+  // distances to the prefixes of 'word' with lengths d - k ... d + k (the
+  // others are greater than k), and only the rows of the current path are
+  // kept, so memory is proportional to depth * k instead of to depth * size.
+  const size_t k = maxDistance, width = 2 * k + 1, far = k + 1;
+  const size_t length = word.size();
+  WordCountList result;
+  std::string current;
+
+  // Row of the root: distance from the empty string to each prefix of word.
+  std::vector<size_t> rows(width, far);
+  for (size_t i = 0; i <= std::min(k, length); i++)
+    rows[k + i] = i;
+
+  // Record the node if it is close enough. Return whether to visit its
+  // subtree (no word below can get closer than the row minimum).
+  auto visitNode = [&](uint32_t node, size_t depth) {
+    const size_t *row = &rows[depth * width];
+    if (m_nodeData[node].count && length + k >= depth &&
+        length <= depth + k && row[length + k - depth] <= k)
+      result.emplace_back(current, m_nodeData[node].count);
+    return *std::min_element(row, row + width) <= k;
+  };
+
+  // Depth-first walk with an explicit stack (words may be very long).
+  struct Frame {
+    uint32_t node, nextChild;
+  };
+  std::vector<Frame> stack;
+  if (visitNode(0, 0))
+    stack.push_back({0, m_nodeData[0].firstChild});
+
+  while (!stack.empty()) {
+    Frame &frame = stack.back();
+    if (frame.nextChild == m_nodeData[frame.node].firstChild +
+                               m_nodeData[frame.node].numChildren) {
+      stack.pop_back();
+      if (!stack.empty())
+        current.pop_back();
+      continue;
+    }
+
+    // Compute the row of the next child from the row of its parent.
+    uint32_t child = frame.nextChild++;
+    size_t depth = stack.size();
+    char c = m_labelData[child];
+    rows.resize((depth + 1) * width);
+    const size_t *row = &rows[(depth - 1) * width];
+    size_t *next = &rows[depth * width];
+
+    for (size_t j = 0; j < width; j++) {
+      if (depth + j < k || depth + j - k > length) { // Prefix out of range
+        next[j] = far;
+        continue;
+      }
+
+      size_t i = depth + j - k; // Length of the prefix of 'word'
+      size_t best = i ? row[j] + (word[i - 1] == c ? 0 : 1) : depth;
+      if (i && j)
+        best = std::min(best, next[j - 1] + 1);
+      if (j + 1 < width)
+        best = std::min(best, row[j + 1] + 1);
+      next[j] = std::min(best, far);
+    }
+
+    current.push_back(c);
+    if (visitNode(child, depth))
+      stack.push_back({child, m_nodeData[child].firstChild});
+    else
+      current.pop_back();
+  }
+
+  return result;
+}
+
+uint32_t WordsIndex::findChild(uint32_t node, char c) const {
+  auto begin = m_labelData + m_nodeData[node].firstChild;
+  auto end = begin + m_nodeData[node].numChildren;
+  auto iter = std::lower_bound(begin, end, c, [](char a, char b) {
+    return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+  });
+
+  if (iter == end || *iter != c)
+    return 0;
+  return static_cast<uint32_t>(iter - m_labelData);
+}
+
+void WordsIndex::collect(uint32_t node, std::string &word,
+                         const WordVisitor &visit) const {
+  if (m_nodeData[node].count)
+    visit(word, m_nodeData[node].count);
+
+  // Depth-first walk with an explicit stack (words may be very long).
+  struct Frame {
+    uint32_t node, nextChild;
+  };
+  std::vector<Frame> stack(1, {node, m_nodeData[node].firstChild});
+
+  while (!stack.empty()) {
+    Frame &frame = stack.back();
+    if (frame.nextChild == m_nodeData[frame.node].firstChild +
+                               m_nodeData[frame.node].numChildren) {
+      stack.pop_back();
+      if (!stack.empty())
+        word.pop_back();
+      continue;
+    }
+
+    uint32_t child = frame.nextChild++;
+    word.push_back(m_labelData[child]);
+    if (m_nodeData[child].count)
+      visit(word, m_nodeData[child].count);
+    stack.push_back({child, m_nodeData[child].firstChild});
+  }
+}
@@ -1,9 +1,14 @@
 #ifndef TESTS_WORDS_HPP
 #define TESTS_WORDS_HPP
 
+#include <chrono>
+#include <condition_variable>
 #include <sstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
+#include "word_sort.hpp"
 #include "words.hpp"
 
 /// Tests for WordsStorage.
@@ -55,6 +60,34 @@ private:
 	std::ostringstream newCout; // Reirected cout
 };
 
+/**
+	@class StdinHolder
+	@brief Replace STDIN with a pipe that stays open and empty.
+
+	Reading the real STDIN (descriptor 0) while it is held blocks, as it does
+	on a terminal or on a pipe whose writer is still running. So that a test
+	can't hang, the pipe is closed (EOF) after 'timeout'. Only available on
+	POSIX systems; elsewhere, STDIN is left as it is.
+*/
+class StdinHolder
+{
+public:
+	explicit StdinHolder(std::chrono::milliseconds timeout);
+	~StdinHolder();
+
+	/// Restore STDIN. Return whether the timeout expired before.
+	bool reset();
+
+private:
+	int originalStdin; // Duplicate of the original descriptor 0 (-1 if none)
+	int writeEnd; // Write end of the pipe (-1 once closed)
+	bool done; // Whether reset() was called
+	bool expired; // Whether the timeout expired
+	std::mutex mutex;
+	std::condition_variable doneChanged;
+	std::thread watchdog; // Closes the pipe after the timeout
+};
+
 /**
 	@class Test_WordsStorage
 	@brief Tool for testing the WordsStorage interface.
@@ -69,8 +102,79 @@ public:
 	/// Test WordsStorage::readInputWords.
 	bool readInputWords(WordsStorage& subject, std::string input);
 
-	/// Test WordsStorage::lookupWords.
-	bool lookupWords(WordsStorage& subject, std::string input, size_t expected);
+	/// Test WordsStorage::readInputFiles. Each element of 'contents' is written
+	/// to its own temporary file. If 'asDirectory', their directory is passed.
+	bool readInputFiles(WordsStorage& subject, std::vector<std::string> contents,
+	                    bool asDirectory = false);
+
+	/// Test that WordsStorage::readInputFiles rejects a missing file (in the
+	/// middle of 'numFiles' valid ones) and leaves storage unchanged.
+	bool missingInputFile(size_t numFiles);
+
+	/**
+		@brief Test WordsStorage count files (exportCounts, mergeCountFiles and
+		readCountFiles).
+
+		Each element of 'shards' is read by its own WordsStorage (as STDIN
+		input) and exported to a count file. Count files are then merged
+		pairwise and all at once, and both results are read into new storages
+		whose word lists must match 'expected' (as printed by printWordsList).
+	*/
+	bool countFiles(std::vector<std::string> shards, std::string expected);
+
+	/**
+		@brief Test WordsStorage::mergeCountFiles with its output as an input.
+
+		The words of 'first' and 'second' are exported to two count files, and
+		the first one is merged with itself and the second one into itself. A
+		merge failing (missing input) must then leave it unchanged, and its
+		word list must match 'expected', without temporary files left.
+	*/
+	bool mergeInPlace(std::string first, std::string second, std::string expected);
+
+	/// Test that WordsStorage::readCountFiles rejects a corrupt count file
+	/// (after a valid one) and leaves storage unchanged.
+	bool corruptCountFile(std::string data);
+
+	/// Test mergeWordRuns on 'numRuns' run files, opening at most 'maxFanIn'
+	/// at once. No intermediate run file may be left.
+	bool mergeRuns(size_t numRuns, size_t maxFanIn);
+
+	/**
+		@brief Test WordsStorage::publishShared and attachShared.
+
+		Each element of 'versions' is read by its own WordsStorage (as STDIN
+		input) and published with the same name. After each publication, an
+		attached storage must print the same word list and lookup answers as
+		the storage that published it, and a storage attached to the first
+		version must still print the first word list.
+	*/
+	bool sharedWords(std::vector<std::string> versions, std::string lookups);
+
+	/// Test WordsStorage::lookupWords. 'suggestions' is the expected list of
+	/// similar words printed when the word is not found ("" for none).
+	bool lookupWords(WordsStorage& subject, std::string input, size_t expected,
+	                 std::string suggestions = "");
+
+	/// Test WordsStorage::lookupWords while STDIN is held open (see StdinHolder).
+	/// Redirected input must not wait for STDIN. 'expected' is the whole output.
+	bool lookupWordsStdinOpen(WordsStorage& subject, std::string input,
+	                          std::string expected);
+
+	/**
+		@brief Test the words application through a pipe.
+
+		The words binary reads 'words' and then 'lookup' from a pipe that is
+		kept open. 'answer' must be printed before the pipe is closed (EOF).
+		Only run on POSIX systems.
+	*/
+	bool wordsBinaryPipe(std::string words, std::string lookup, std::string answer);
+
+	/// Test WordsStorage::findPrefix. 'expected' has one "word count\n" per match.
+	bool findPrefix(const WordsStorage& subject, std::string prefix, std::string expected);
+
+	/// Test WordsStorage::findSimilar. 'expected' has one "word count\n" per match.
+	bool findSimilar(const WordsStorage& subject, std::string word, std::string expected);
 
 	/// Test WordsStorage::printWordsList.
 	bool printWordsList(const WordsStorage& subject, std::string expected);
@@ -78,11 +182,43 @@ public:
 	/// Test WordsStorage::printWordsFound.
 	bool printWordsFound(const WordsStorage& subject, size_t expected);
 
+	/**
+		@brief Test that Scheduler::run rethrows the exception of a task.
+
+		A pipeline of three stages passes 'numItems' numbers through channels
+		of one item. The middle stage throws when it receives 'failAt', leaving
+		the other stages waiting: run() must rethrow its exception instead of
+		reporting a deadlock.
+	*/
+	bool schedulerError(size_t numItems, size_t failAt);
+
+	/// Test parallelSort on 'size' pseudo-random words split in 'numChunks' chunks.
+	bool parallelSort(size_t size, unsigned numChunks);
+
+	/// Test ExternalWordSorter. 'words' are separated by '\n'. 'expectSpill'
+	/// tells whether the budget should force run files to be written.
+	bool externalSort(std::string words, size_t memoryBudget, bool expectSpill,
+	                  std::string expected);
+
+	/**
+		@brief Test WordsStorage::setMemoryBudget.
+
+		'input' is read (as STDIN input) by a storage limited to
+		'memoryBudget' bytes. Its word list must match 'expected', also after
+		exporting it to a count file and reading it back, and whether it was
+		spilled to disk must match 'expectSpill' (lookups must then throw).
+	*/
+	bool memoryBudget(std::string input, size_t memoryBudget, bool expectSpill,
+	                  std::string expected);
+
 private:
 	size_t testsCount;
 
 	void printOk();
 	void printFail();
+
+	/// Print OK or FAIL depending on whether a result matches the expected one.
+	bool checkWordCounts(const WordCountList& result, const std::string& expected);
 };
 
 #endif
\ No newline at end of file
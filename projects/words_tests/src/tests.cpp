@@ -1,11 +1,58 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <stdexcept>
+
 #include "tests.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/// Pipeline stage that pushes the numbers from 0 to 'count' - 1.
+Task produceNumbers(Channel<size_t> &numbers, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    if (!co_await numbers.push(i))
+      break;
+  numbers.close();
+}
+
+/// Pipeline stage that passes the numbers on, and throws when receiving
+/// 'failAt' without closing any channel (the other stages are left waiting).
+Task forwardNumbers(Channel<size_t> &input, Channel<size_t> &output,
+                    size_t failAt) {
+  while (std::optional<size_t> number = co_await input.pop()) {
+    if (*number == failAt)
+      throw std::runtime_error("Stage failure");
+    co_await output.push(*number);
+  }
+  output.close();
+}
+
+/// Pipeline stage that counts the numbers received.
+Task countNumbers(Channel<size_t> &numbers, size_t &count) {
+  while (std::optional<size_t> number = co_await numbers.pop())
+    count++;
+}
+
+} // namespace
+
 InputRedirector::InputRedirector(const std::string &input)
     : originalCin(std::cin.rdbuf()), newCin(input) {
   std::cin.rdbuf(newCin.rdbuf()); // Redirect std::cin
+  Scheduler::setStdinRedirected(true);
 }
 
-void InputRedirector::reset() { std::cin.rdbuf(originalCin); }
+void InputRedirector::reset() {
+  std::cin.rdbuf(originalCin);
+  Scheduler::setStdinRedirected(false);
+}
 
 std::string InputRedirector::getInput() { return newCin.str(); }
 
@@ -17,6 +64,55 @@ void OutputRedirector::reset() { std::cout.rdbuf(originalCout); }
 
 std::string OutputRedirector::inputData() { return newCout.str(); }
 
+StdinHolder::StdinHolder(std::chrono::milliseconds timeout)
+    : originalStdin(-1), writeEnd(-1), done(false), expired(false) {
+#if defined(__unix__) || defined(__APPLE__)
+  int fds[2];
+  if (pipe(fds))
+    return;
+  originalStdin = dup(0);
+  dup2(fds[0], 0);
+  close(fds[0]);
+  writeEnd = fds[1];
+
+  watchdog = std::thread([this, timeout] {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!doneChanged.wait_for(lock, timeout, [this] { return done; })) {
+      expired = true;
+      close(writeEnd); // Readers of STDIN get EOF
+      writeEnd = -1;
+    }
+  });
+#else
+  (void)timeout;
+#endif
+}
+
+StdinHolder::~StdinHolder() { reset(); }
+
+bool StdinHolder::reset() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  doneChanged.notify_all();
+  if (watchdog.joinable())
+    watchdog.join();
+
+#if defined(__unix__) || defined(__APPLE__)
+  if (writeEnd >= 0) {
+    close(writeEnd);
+    writeEnd = -1;
+  }
+  if (originalStdin >= 0) {
+    dup2(originalStdin, 0);
+    close(originalStdin);
+    originalStdin = -1;
+  }
+#endif
+  return expired;
+}
+
 Test_WordsStorage::Test_WordsStorage() : testsCount(0) {}
 
 bool Test_WordsStorage::readInputWords(WordsStorage &subject,
@@ -42,8 +138,362 @@ bool Test_WordsStorage::readInputWords(WordsStorage &subject,
   return false;
 }
 
+bool Test_WordsStorage::readInputFiles(WordsStorage &subject,
+                                       std::vector<std::string> contents,
+                                       bool asDirectory) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("words_tests_" + std::to_string(testsCount));
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < contents.size(); i++) {
+    paths.push_back((dir / ("input_" + std::to_string(i) + ".txt")).string());
+    std::ofstream(paths.back()) << contents[i];
+  }
+  if (asDirectory)
+    paths.assign(1, dir.string());
+
+  // Act (execution)
+  bool failed = false;
+  try {
+    subject.readInputFiles(paths);
+  }
+
+  // Assert (verification)
+  catch (const std::exception &e) {
+    failed = true;
+  }
+
+  std::filesystem::remove_all(dir);
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
+bool Test_WordsStorage::missingInputFile(size_t numFiles) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("words_tests_" + std::to_string(testsCount));
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < numFiles; i++) {
+    paths.push_back((dir / ("input_" + std::to_string(i) + ".txt")).string());
+    std::ofstream(paths.back()) << "helmet\nshield\n";
+  }
+  // Valid files are read before and after it, whatever the order of chunks.
+  paths.insert(paths.begin() + numFiles / 2, (dir / "missing.txt").string());
+
+  WordsStorage subject;
+  InputRedirector inputDir("sword\nbow\nend");
+  subject.readInputWords();
+  inputDir.reset();
+
+  // Act (execution)
+  bool rejected = false;
+  try {
+    subject.readInputFiles(paths);
+  }
+
+  // Assert (verification)
+  catch (const std::runtime_error &e) {
+    rejected = true;
+  }
+
+  OutputRedirector outputDir;
+  subject.printWordsList();
+  outputDir.reset();
+  std::filesystem::remove_all(dir);
+  if (rejected &&
+      outputDir.inputData() == "\n=== Word list:\nbow 1\nsword 1\n") {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_WordsStorage::countFiles(std::vector<std::string> shards,
+                                   std::string expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("words_tests_" + std::to_string(testsCount));
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  std::string allOutput, pairOutput;
+  bool failed = false;
+
+  try {
+    for (size_t i = 0; i < shards.size(); i++) {
+      WordsStorage shard;
+      InputRedirector inputDir(shards[i]);
+      shard.readInputWords();
+      inputDir.reset();
+      paths.push_back((dir / ("shard_" + std::to_string(i) + ".bin")).string());
+      shard.exportCounts(paths.back());
+    }
+
+    // Act (execution)
+    WordsStorage all, pairwise;
+    std::string merged = (dir / "merged.bin").string();
+    WordsStorage::mergeCountFiles(paths, merged);
+    all.readCountFiles({merged});
+
+    std::string accumulated = (dir / "accumulated_0.bin").string();
+    WordsStorage::mergeCountFiles({}, accumulated);
+    for (size_t i = 0; i < paths.size(); i++) {
+      std::string next =
+          (dir / ("accumulated_" + std::to_string(i + 1) + ".bin")).string();
+      WordsStorage::mergeCountFiles({accumulated, paths[i]}, next);
+      accumulated = next;
+    }
+    pairwise.readCountFiles({accumulated});
+
+    OutputRedirector outputDir;
+    all.printWordsList();
+    allOutput = outputDir.inputData();
+    pairwise.printWordsList();
+    pairOutput = outputDir.inputData().substr(allOutput.size());
+    outputDir.reset();
+  } catch (const std::exception &e) {
+    failed = true;
+  }
+
+  // Assert (verification)
+  std::filesystem::remove_all(dir);
+  failed = failed || allOutput != expected || pairOutput != expected;
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
+bool Test_WordsStorage::mergeInPlace(std::string first, std::string second,
+                                     std::string expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("words_tests_" + std::to_string(testsCount));
+  std::filesystem::create_directories(dir);
+  std::string firstPath = (dir / "first.bin").string();
+  std::string secondPath = (dir / "second.bin").string();
+  std::string missingPath = (dir / "missing.bin").string();
+  std::string output;
+  bool failed = false, rejected = false;
+
+  try {
+    WordsStorage firstShard, secondShard;
+    InputRedirector inputDir(first + "\nend\n" + second + "\nend\n");
+    firstShard.readInputWords();
+    secondShard.readInputWords();
+    inputDir.reset();
+    firstShard.exportCounts(firstPath);
+    secondShard.exportCounts(secondPath);
+
+    // Act (execution)
+    WordsStorage::mergeCountFiles({firstPath, firstPath, secondPath},
+                                  firstPath);
+    try {
+      WordsStorage::mergeCountFiles({firstPath, missingPath}, firstPath);
+    } catch (const std::runtime_error &e) {
+      rejected = true;
+    }
+
+    WordsStorage merged;
+    merged.readCountFiles({firstPath});
+    OutputRedirector outputDir;
+    merged.printWordsList();
+    outputDir.reset();
+    output = outputDir.inputData();
+  } catch (const std::exception &e) {
+    failed = true;
+  }
+
+  // Assert (verification)
+  size_t filesLeft = std::distance(std::filesystem::directory_iterator(dir),
+                                   std::filesystem::directory_iterator());
+  std::filesystem::remove_all(dir);
+
+  failed = failed || !rejected || output != expected || filesLeft != 2;
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
+bool Test_WordsStorage::corruptCountFile(std::string data) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("words_tests_" + std::to_string(testsCount));
+  std::filesystem::create_directories(dir);
+  std::string valid = (dir / "valid.bin").string();
+  std::string corrupt = (dir / "corrupt.bin").string();
+  std::ofstream(corrupt, std::ios_base::binary) << data;
+
+  WordsStorage subject, counts;
+  InputRedirector inputDir("sword\nbow\nend\nsword\nshield\nend");
+  subject.readInputWords();
+  counts.readInputWords();
+  inputDir.reset();
+  counts.exportCounts(valid);
+
+  // Act (execution)
+  bool rejected = false;
+  try {
+    subject.readCountFiles({valid, corrupt});
+  }
+
+  // Assert (verification)
+  catch (const std::runtime_error &e) {
+    rejected = true;
+  }
+
+  OutputRedirector outputDir;
+  subject.printWordsList();
+  outputDir.reset();
+  std::filesystem::remove_all(dir);
+
+  if (rejected &&
+      outputDir.inputData() == "\n=== Word list:\nbow 1\nsword 1\n") {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_WordsStorage::mergeRuns(size_t numRuns, size_t maxFanIn) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("words_tests_" + std::to_string(testsCount));
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  std::map<std::string, size_t> expected;
+  for (size_t i = 0; i < numRuns; i++) {
+    paths.push_back((dir / ("run_" + std::to_string(i) + ".bin")).string());
+    WordRunWriter writer(paths.back());
+    for (size_t j = 0; j < 100; j += i % 7 + 1) {
+      std::string word = "w" + std::to_string(1000 + j);
+      writer.write(word, i + 1);
+      expected[word] += i + 1;
+    }
+    writer.close();
+  }
+
+  // Act (execution)
+  std::string output;
+  bool failed = false;
+  try {
+    mergeWordRuns(
+        paths,
+        [&output](const std::string &word, size_t count) {
+          output += word + " " + std::to_string(count) + "\n";
+        },
+        maxFanIn, dir.string());
+  } catch (const std::exception &e) {
+    failed = true;
+  }
+
+  // Assert (verification)
+  size_t filesLeft = std::distance(std::filesystem::directory_iterator(dir),
+                                   std::filesystem::directory_iterator());
+  std::filesystem::remove_all(dir);
+
+  std::string expectedOutput;
+  for (const auto &p : expected)
+    expectedOutput += p.first + " " + std::to_string(p.second) + "\n";
+
+  failed = failed || output != expectedOutput || filesLeft != numRuns;
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
+bool Test_WordsStorage::sharedWords(std::vector<std::string> versions,
+                                    std::string lookups) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string name = "words_tests_" + std::to_string(std::random_device()()) +
+                     "_" + std::to_string(testsCount);
+  bool failed = false;
+
+  try {
+    WordsStorage attached, firstVersion;
+    std::string firstList;
+
+    for (size_t i = 0; i < versions.size(); i++) {
+      WordsStorage local;
+      InputRedirector inputDir(versions[i]);
+      local.readInputWords();
+      inputDir.reset();
+
+      // Act (execution)
+      local.publishShared(name);
+      if (!i) {
+        attached.attachShared(name);
+        firstVersion.attachShared(name);
+      }
+
+      OutputRedirector outputDir;
+      local.printWordsList();
+      std::string localList = outputDir.inputData();
+      InputRedirector localLookups(lookups);
+      local.lookupWords();
+      localLookups.reset();
+      std::string localOutput = outputDir.inputData();
+
+      InputRedirector attachedLookups(lookups);
+      attached.lookupWords(); // Switches to the new version
+      attachedLookups.reset();
+      std::string attachedOutput = outputDir.inputData();
+      attached.printWordsList();
+      std::string attachedList = outputDir.inputData();
+      firstVersion.printWordsList();
+      std::string firstVersionList = outputDir.inputData();
+      outputDir.reset();
+
+      // Assert (verification)
+      if (!i)
+        firstList = localList;
+      failed = failed ||
+               attachedOutput.substr(localOutput.size()) !=
+                   localOutput.substr(localList.size()) ||
+               attachedList.substr(attachedOutput.size()) != localList ||
+               firstVersionList.substr(attachedList.size()) != firstList;
+    }
+  } catch (const std::exception &e) {
+    failed = true;
+  }
+
+  SharedWords::remove(name);
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
 bool Test_WordsStorage::lookupWords(WordsStorage &subject, std::string input,
-                                    size_t expected) {
+                                    size_t expected, std::string suggestions) {
   testsCount++;
 
   // Arrange (setup)
@@ -65,6 +515,8 @@ bool Test_WordsStorage::lookupWords(WordsStorage &subject, std::string input,
   else if (input.size())
     expectedOutput = "\nEnter a word for lookup:" + input +
                      " was NOT found in the initial word list\n" +
+                     (suggestions.size() ? "Did you mean: " + suggestions + "?\n"
+                                         : "") +
                      "\nEnter a word for lookup:";
   else
     expectedOutput = "\nEnter a word for lookup:";
@@ -78,6 +530,108 @@ bool Test_WordsStorage::lookupWords(WordsStorage &subject, std::string input,
   }
 }
 
+bool Test_WordsStorage::lookupWordsStdinOpen(WordsStorage &subject,
+                                             std::string input,
+                                             std::string expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  StdinHolder stdinHolder(std::chrono::seconds(5));
+  InputRedirector inputDir(input);
+  OutputRedirector outputDir;
+
+  // Act (execution)
+  subject.lookupWords();
+  inputDir.reset();
+  outputDir.reset();
+  bool waited = stdinHolder.reset();
+
+  // Assert (verification)
+  if (!waited && outputDir.inputData() == expected) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_WordsStorage::wordsBinaryPipe(std::string words, std::string lookup,
+                                        std::string answer) {
+  testsCount++;
+
+  bool answered = false;
+#if defined(__unix__) || defined(__APPLE__)
+  // Arrange (setup)
+  int toWords[2], fromWords[2];
+  if (pipe(toWords) || pipe(fromWords)) {
+    printFail();
+    return true;
+  }
+  std::signal(SIGPIPE, SIG_IGN); // Don't die if words exits early
+
+  pid_t pid = fork();
+  if (pid == 0) { // Child: run words on the pipes
+    dup2(toWords[0], 0);
+    dup2(fromWords[1], 1);
+    close(toWords[0]);
+    close(toWords[1]);
+    close(fromWords[0]);
+    close(fromWords[1]);
+    execl(WORDS_BINARY, WORDS_BINARY, static_cast<char *>(nullptr));
+    _exit(127);
+  }
+  close(toWords[0]);
+  close(fromWords[1]);
+
+  // Act (execution)
+  // The lookup is written without closing the pipe: its answer must arrive
+  // while words still waits for more input.
+  std::string input = words + lookup;
+  if (pid > 0 && write(toWords[1], input.data(), input.size()) ==
+                     static_cast<ssize_t>(input.size())) {
+    std::string output;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!answered) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      pollfd polled{fromWords[0], POLLIN, 0};
+      if (left.count() <= 0 || poll(&polled, 1, left.count()) <= 0)
+        break;
+
+      char buffer[4096];
+      ssize_t count = read(fromWords[0], buffer, sizeof(buffer));
+      if (count <= 0)
+        break;
+      output.append(buffer, count);
+      answered = output.find(answer) != std::string::npos;
+    }
+  }
+
+  close(toWords[1]); // EOF: words finishes
+  char buffer[4096];
+  while (read(fromWords[0], buffer, sizeof(buffer)) > 0)
+    ;
+  close(fromWords[0]);
+  if (pid > 0)
+    waitpid(pid, nullptr, 0);
+#else
+  (void)words;
+  (void)lookup;
+  (void)answer;
+  answered = true;
+#endif
+
+  // Assert (verification)
+  if (answered) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
 bool Test_WordsStorage::printWordsList(const WordsStorage &subject,
                                        std::string expected) {
   testsCount++;
@@ -121,6 +675,172 @@ bool Test_WordsStorage::printWordsFound(const WordsStorage &subject,
   }
 }
 
+bool Test_WordsStorage::findPrefix(const WordsStorage &subject,
+                                   std::string prefix, std::string expected) {
+  testsCount++;
+  return checkWordCounts(subject.findPrefix(prefix), expected);
+}
+
+bool Test_WordsStorage::findSimilar(const WordsStorage &subject,
+                                    std::string word, std::string expected) {
+  testsCount++;
+  return checkWordCounts(subject.findSimilar(word), expected);
+}
+
+bool Test_WordsStorage::schedulerError(size_t numItems, size_t failAt) {
+  testsCount++;
+
+  // Arrange (setup)
+  Scheduler scheduler;
+  Channel<size_t> numbers(scheduler, 1), forwarded(scheduler, 1);
+  size_t count = 0;
+  scheduler.spawn(produceNumbers(numbers, numItems));
+  scheduler.spawn(forwardNumbers(numbers, forwarded, failAt));
+  scheduler.spawn(countNumbers(forwarded, count));
+
+  // Act (execution)
+  std::string error;
+  try {
+    scheduler.run();
+  } catch (const std::exception &e) {
+    error = e.what();
+  }
+
+  // Assert (verification)
+  bool failed = failAt < numItems ? error != "Stage failure"
+                                  : error != "" || count != numItems;
+  if (failed)
+    printFail();
+  else
+    printOk();
+  return failed;
+}
+
+bool Test_WordsStorage::parallelSort(size_t size, unsigned numChunks) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::mt19937 random(static_cast<unsigned>(size));
+  std::uniform_int_distribution<int> letter('A', 'z');
+  WordCountList words(size);
+  for (auto &p : words) {
+    p.first.resize(1 + random() % 8);
+    for (char &c : p.first)
+      c = static_cast<char>(letter(random));
+  }
+  WordCountList expected(words);
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<std::string, size_t> &a,
+                      const std::pair<std::string, size_t> &b) {
+                     return a.first < b.first;
+                   });
+
+  // Act (execution)
+  sortWordCounts(words, numChunks);
+
+  // Assert (verification)
+  bool sorted = words.size() == expected.size();
+  for (size_t i = 0; sorted && i < words.size(); i++)
+    sorted = words[i].first == expected[i].first;
+
+  if (sorted) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_WordsStorage::externalSort(std::string words, size_t memoryBudget,
+                                     bool expectSpill, std::string expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  ExternalWordSorter sorter(memoryBudget);
+  std::istringstream iss(words);
+  std::string word;
+  while (std::getline(iss, word))
+    sorter.add(word);
+
+  // Act (execution)
+  std::string output;
+  try {
+    sorter.merge([&output](const std::string &word, size_t count) {
+      output += word + " " + std::to_string(count) + "\n";
+    });
+  } catch (const std::exception &e) {
+    printFail();
+    return true;
+  }
+
+  // Assert (verification)
+  if (output == expected && (sorter.numRuns() > 0) == expectSpill) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_WordsStorage::memoryBudget(std::string input, size_t memoryBudget,
+                                     bool expectSpill, std::string expected) {
+  testsCount++;
+
+  // Arrange (setup)
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("words_tests_" + std::to_string(testsCount) + ".bin"))
+                         .string();
+  WordsStorage subject, reloaded;
+  subject.setMemoryBudget(memoryBudget);
+  reloaded.setMemoryBudget(memoryBudget);
+
+  // Act (execution)
+  InputRedirector inputDir(input);
+  OutputRedirector outputDir;
+  bool lookupRejected = false;
+  try {
+    subject.readInputWords();
+    subject.printWordsList();
+    subject.exportCounts(path);
+    reloaded.readCountFiles({path});
+    reloaded.printWordsList();
+    subject.lookupWords();
+  } catch (const std::logic_error &e) {
+    lookupRejected = true;
+  } catch (const std::exception &e) {
+  }
+  inputDir.reset();
+  outputDir.reset();
+  std::filesystem::remove(path);
+
+  // Assert (verification)
+  if (outputDir.inputData().rfind(expected + expected, 0) == 0 &&
+      subject.isSpilled() == expectSpill && lookupRejected == expectSpill) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
+bool Test_WordsStorage::checkWordCounts(const WordCountList &result,
+                                        const std::string &expected) {
+  std::string output;
+  for (const auto &p : result)
+    output += p.first + " " + std::to_string(p.second) + "\n";
+
+  if (output == expected) {
+    printOk();
+    return false;
+  } else {
+    printFail();
+    return true;
+  }
+}
+
 void Test_WordsStorage::printOk() {
   std::cout << "OK - Test " << testsCount << std::endl;
 }
@@ -141,19 +861,162 @@ void tests() {
   test.readInputWords(wordsSet, "sword2\nbow sword\nshield helmet\nend");
   test.readInputWords(wordsSet, "\nsword\n\nhelmet shie1d\n\n\nend\n\n");
 
+  std::cout << "Testing WordsStorage::readInputFiles():" << std::endl;
+
+  WordsStorage wordsSet_files, wordsSet_dir;
+  test.readInputFiles(wordsSet_files, {});
+  test.readInputFiles(wordsSet_files, {""});
+  test.readInputFiles(wordsSet_files,
+                      {"sword\nbow\nend\nhelmet", "sword2\nbow sword\n",
+                       "\n  shield helmet\n\nend\nend\nsword"});
+  test.readInputFiles(wordsSet_dir, {"sword\nend", "Sword\nbow\n5bow"}, true);
+  test.missingInputFile(0);
+  test.missingInputFile(100);
+
   std::cout << "Testing WordsStorage::printWordsList():" << std::endl;
 
   test.printWordsList(wordsSet_empty, "\n=== Word list:\n");
   test.printWordsList(wordsSet,
                       "\n=== Word list:\nbow 2\nhelmet 2\nshield 1\nsword 3\n");
+  test.printWordsList(wordsSet_files,
+                      "\n=== Word list:\nbow 2\nshield 1\nsword 1\n");
+  test.printWordsList(wordsSet_dir, "\n=== Word list:\nSword 1\nbow 1\nsword 1\n");
 
   std::cout << "Testing WordsStorage::lookupWords():" << std::endl;
 
   test.lookupWords(wordsSet, "", 0);
   test.lookupWords(wordsSet, "xyz", 0);
   test.lookupWords(wordsSet, "sword", 3);
-  test.lookupWords(wordsSet, "sword2", 0);
+  test.lookupWords(wordsSet, "sword2", 0, "sword");
   test.lookupWords(wordsSet, "bow sword", 0);
+  test.lookupWords(wordsSet, "sord", 0, "sword");
+  test.lookupWordsStdinOpen(wordsSet, "", "\nEnter a word for lookup:");
+  test.lookupWordsStdinOpen(wordsSet, "xyz\n",
+                            "\nEnter a word for lookup:xyz was NOT found in "
+                            "the initial word list\n"
+                            "\nEnter a word for lookup:");
+  test.wordsBinaryPipe("sword\nbow\nend\n", "sword\n",
+                       "Success: sword was present 1 times");
+  test.wordsBinaryPipe("sword\nend\n", "bow\n",
+                       "bow was NOT found in the initial word list");
+
+  std::cout << "Testing WordsStorage::findPrefix():" << std::endl;
+
+  test.findPrefix(wordsSet_empty, "", "");
+  test.findPrefix(wordsSet, "", "bow 2\nhelmet 2\nshield 1\nsword 3\n");
+  test.findPrefix(wordsSet, "s", "shield 1\nsword 3\n");
+  test.findPrefix(wordsSet, "sword", "sword 3\n");
+  test.findPrefix(wordsSet, "swords", "");
+  test.findPrefix(wordsSet, "x", "");
+
+  std::cout << "Testing WordsStorage::findSimilar():" << std::endl;
+
+  test.findSimilar(wordsSet_empty, "sword", "");
+  test.findSimilar(wordsSet, "sword", "sword 3\n");
+  test.findSimilar(wordsSet, "swords", "sword 3\n");
+  test.findSimilar(wordsSet, "swrd", "sword 3\n");
+  test.findSimilar(wordsSet, "swird", "sword 3\n");
+  test.findSimilar(wordsSet, "bo", "bow 2\n");
+  test.findSimilar(wordsSet, "xyz", "");
+  test.findSimilar(wordsSet, "swo", "");
+
+  std::cout << "Testing long words:" << std::endl;
+
+  // Longer than the stack would allow for recursive trie walks.
+  std::string longWord(200000, 'a');
+  std::string longMiss(longWord);
+  longMiss[longMiss.size() / 2] = 'b';
+  WordsStorage wordsSet_long;
+  test.readInputWords(wordsSet_long, "aa\n" + longWord + "\nend");
+  test.printWordsList(wordsSet_long,
+                      "\n=== Word list:\naa 1\n" + longWord + " 1\n");
+  test.findPrefix(wordsSet_long, "a", "aa 1\n" + longWord + " 1\n");
+  test.findSimilar(wordsSet_long, longMiss, longWord + " 1\n");
+  test.findSimilar(wordsSet_long, longMiss + "b", "");
+  test.findSimilar(wordsSet_long, "ab", "aa 1\n");
+  test.lookupWords(wordsSet_long, longWord, 1);
+  test.lookupWords(wordsSet_long, longMiss, 0); // Too long for suggestions
+
+  std::cout << "Testing Scheduler:" << std::endl;
+
+  test.schedulerError(0, 0);
+  test.schedulerError(10, 10);
+  test.schedulerError(10, 0);
+  test.schedulerError(10, 5);
+
+  std::cout << "Testing parallelSort():" << std::endl;
+
+  test.parallelSort(0, 4);
+  test.parallelSort(100, 4);
+  test.parallelSort(50000, 1);
+  test.parallelSort(50000, 3);
+  test.parallelSort(50000, 8);
+
+  std::cout << "Testing ExternalWordSorter:" << std::endl;
+
+  test.externalSort("", 1 << 20, false, "");
+  test.externalSort("sword\nbow\nsword\nBow", 1 << 20, false,
+                    "Bow 1\nbow 1\nsword 2\n");
+  test.externalSort("sword\nbow\nsword\nBow", 1, true,
+                    "Bow 1\nbow 1\nsword 2\n");
+  test.externalSort("c\nb\na\nc\nb\nc\nd\na", 100, true,
+                    "a 2\nb 2\nc 3\nd 1\n");
+
+  std::cout << "Testing WordsStorage::setMemoryBudget():" << std::endl;
+
+  test.memoryBudget("end", 1, false, "\n=== Word list:\n");
+  test.memoryBudget("sword\nbow\nsword\nBow\nend", 1 << 20, false,
+                    "\n=== Word list:\nBow 1\nbow 1\nsword 2\n");
+  test.memoryBudget("sword\nbow\nsword\nBow\nend", 1, true,
+                    "\n=== Word list:\nBow 1\nbow 1\nsword 2\n");
+  test.memoryBudget("c\nb\na\nc\nb\nc\nd\na\nend", 200, true,
+                    "\n=== Word list:\na 2\nb 2\nc 3\nd 1\n");
+  std::string indexedWord(100, 'w'); // The table fits, but not its index
+  test.memoryBudget(indexedWord + "\nend", 1000, true,
+                    "\n=== Word list:\n" + indexedWord + " 1\n");
+  test.memoryBudget(indexedWord + "\nend", 4000, false,
+                    "\n=== Word list:\n" + indexedWord + " 1\n");
+
+  std::cout << "Testing WordsStorage count files:" << std::endl;
+
+  test.countFiles({}, "\n=== Word list:\n");
+  test.countFiles({"end"}, "\n=== Word list:\n");
+  test.countFiles({"sword\nbow\nend", "bow\nshield\nBow\nend", "end",
+                   "sword\nsword\nhelmet\nend"},
+                  "\n=== Word list:\nBow 1\nbow 2\nhelmet 1\nshield 1\nsword 3\n");
+
+  test.mergeInPlace("", "", "\n=== Word list:\n");
+  test.mergeInPlace("sword\nbow\nsword", "bow\nshield",
+                    "\n=== Word list:\nbow 3\nshield 1\nsword 4\n");
+
+  std::string header("WRUN\x01\0\0\0", 8);
+  test.corruptCountFile("");
+  test.corruptCountFile("WORD\x01\0\0\0");
+  test.corruptCountFile(header + std::string("\xff\xff\xff\x7f", 4) + "bow");
+  test.corruptCountFile(header + std::string("\x03\0\0\0", 4) + "bow");
+  test.corruptCountFile(header + std::string("\x03\0\0\0", 4) + "bow" +
+                        std::string(8, '\x01') + std::string("\x02\0\0\0", 4) +
+                        "ab" + std::string(8, '\x01'));
+  test.corruptCountFile(header + std::string("\x03\0\0\0", 4) + "bow" +
+                        std::string(8, '\0')); // No occurrences
+
+  std::cout << "Testing mergeWordRuns():" << std::endl;
+
+  test.mergeRuns(0, 2);
+  test.mergeRuns(1, 2);
+  test.mergeRuns(5, 64);
+  test.mergeRuns(5, 2);
+  test.mergeRuns(40, 3);
+  test.mergeRuns(9, 1); // Fan-in of at least 2
+
+  std::cout << "Testing WordsStorage shared words:" << std::endl;
+
+  std::string sharedLookups("sword\nbow\nswor\nsw*\n\nxyz\nBow\n*");
+  test.sharedWords({"end"}, sharedLookups);
+  test.sharedWords({"sword\nbow\nsword\nend"}, sharedLookups);
+  test.sharedWords({"sword\nbow\nsword\nend", "end",
+                    "Bow\nswords\nsword\nswore\nbow\nend"},
+                   sharedLookups);
 
   std::cout << "Testing WordsStorage::printWordsFound():" << std::endl;
 
@@ -178,12 +1041,14 @@ void tests() {
   test.lookupWords(wordsSet_2, "shield", 1);
   test.lookupWords(wordsSet_2, "hammer", 0);
   test.printWordsFound(wordsSet_2, 3);
+  test.findPrefix(wordsSet_2, "b", "bow 3\n");
+  test.findSimilar(wordsSet_2, "shied", "shield 1\n");
 
   WordsStorage wordsSet_3;
   test.readInputWords(wordsSet_3, "sword2\nbow\nsword\n5bow\nsh1eld\nbow\nend");
   test.printWordsList(wordsSet_3, "\n=== Word list:\nbow 2\nsword 1\n");
   test.lookupWords(wordsSet_3, "bow", 2);
-  test.lookupWords(wordsSet_3, "sword2", 0);
+  test.lookupWords(wordsSet_3, "sword2", 0, "sword");
   test.printWordsFound(wordsSet_3, 1);
 
   WordsStorage wordsSet_4;